@@ -34,14 +34,15 @@
 #define MEM_INITIATOR
 #include "softf103.h"
 extern void usb_fifo_transmit(void);
+extern void usb_fifo_receive(void);
 SoftF103_Mem_t mem;
 SoftIO_t sio;
 void __aeabi_assert(const char *expr, const char *file, int line) {
   printf("assert failed: %s(%d): %s\n", file, line, expr); while(1);
 }
 int fputc(int ch, FILE *f) {
-  while (fifo_full(&mem.logging));  // wait others to send
-  fifo_enque(&mem.logging, ch);
+  while (fifo_spsc_full(&mem.logging));  // wait others to send
+  fifo_spsc_enque(&mem.logging, ch);
   USART2->CR1 |= USART_CR1_TXEIE;  // enable tx empty interrupt
 	return ch;
 }
@@ -76,105 +77,132 @@ void SystemClock_Config(void);
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
-void my_before(void* softio, SoftIO_Head_t* head) {
-  uint8_t need_disable_irq = 0;
-  if (head->type == SOFTIO_HEAD_TYPE_READ || head->type == SOFTIO_HEAD_TYPE_WRITE) {
-    if (softio_is_variable_included(sio, *head, mem.gpio_count)) {  // atomic write
-      need_disable_irq = 1;
-    }
-    if (softio_is_variable_included(sio, *head, mem.gpio_count_add)) {  // atomic write
-      need_disable_irq = 1;
-    }
-    if (softio_is_variable_included(sio, *head, mem.adc_count)) {  // atomic write
-      need_disable_irq = 1;
-    }
-    if (softio_is_variable_included(sio, *head, mem.adc_count_add)) {  // atomic write
-      need_disable_irq = 1;
-    }
+// hooks of fields in shared memory, registered in hook_init. a request only calls hooks of the fields it includes
+SoftIO_Hook_t hooks[32];
+void hook_disable_irq(void* softio, SoftIO_Head_t* head) {  // atomic access of counters changed by interrupts
+  __disable_irq();
+}
+void hook_enable_irq(void* softio, SoftIO_Head_t* head) {
+  __enable_irq();
+}
+void hook_read_gpio_in(void* softio, SoftIO_Head_t* head) {
+  mem.gpio_in = GPIOB->IDR >> 8;  // PB15 ~ PB8
+}
+// tagged reads of adc are deferred by my_ready until both conversions are done, so that hooks don't wait in the main loop
+uint8_t adc_state = 0;  // 1: started by my_ready, 2: done (or timeout)
+uint32_t adc_start_tick;
+int my_ready(void* softio, SoftIO_Head_t* head) {
+  if (!softio_is_variable_included(sio, *head, mem.adc1) && !softio_is_variable_included(sio, *head, mem.adc2)) return 1;
+  if (adc_state == 0) {
+    if (HAL_ADC_Start(&hadc2) != HAL_OK || HAL_ADC_Start(&hadc1) != HAL_OK) return 1;  // hooks read 0
+    adc_state = 1;
+    adc_start_tick = HAL_GetTick();
   }
-  if (head->type == SOFTIO_HEAD_TYPE_READ) {
-    if (softio_is_variable_included(sio, *head, mem.gpio_in)) {  // wanna read variable
-      mem.gpio_in = GPIOB->IDR >> 8;  // PB15 ~ PB8
-    }
-    uint8_t softio_is_variable_included_adc1 = softio_is_variable_included(sio, *head, mem.adc1);
-    uint8_t softio_is_variable_included_adc2 = softio_is_variable_included(sio, *head, mem.adc2);
-    if (softio_is_variable_included_adc1 || softio_is_variable_included_adc2) {
-      if (softio_is_variable_included_adc1) mem.adc1 = 0;
-      if (softio_is_variable_included_adc2) mem.adc2 = 0;
-      if (HAL_ADC_Start(&hadc2) == HAL_OK && HAL_ADC_Start(&hadc1) == HAL_OK) {  // read simultaneous
-        if (HAL_ADC_PollForConversion(&hadc2, 100) == HAL_OK && HAL_ADC_PollForConversion(&hadc1, 100) == HAL_OK) {  // timeout = 100ms
-          if (softio_is_variable_included_adc1) mem.adc1 = HAL_ADC_GetValue(&hadc1);  // convert to 16bit
-          if (softio_is_variable_included_adc2) mem.adc2 = HAL_ADC_GetValue(&hadc2);
-        }
-      }
+  if (adc_state == 1 && !(__HAL_ADC_GET_FLAG(&hadc2, ADC_FLAG_EOC) && __HAL_ADC_GET_FLAG(&hadc1, ADC_FLAG_EOC))
+      && HAL_GetTick() - adc_start_tick < 100) return 0;  // timeout = 100ms
+  adc_state = 2;
+  return 1;
+}
+void adc_read_both(uint8_t read1, uint8_t read2) {
+  uint32_t masked = __get_PRIMASK();  // by hook_disable_irq of a counter before adc in the same request, hooks are called in order of address
+  if (masked) __enable_irq();  // HAL_GetTick needs SysTick for the timeout, and USB shouldn't wait for the conversion
+  if (read1) mem.adc1 = 0;
+  if (read2) mem.adc2 = 0;
+  uint8_t started = adc_state == 2;  // by my_ready
+  adc_state = 0;
+  if (started || (HAL_ADC_Start(&hadc2) == HAL_OK && HAL_ADC_Start(&hadc1) == HAL_OK)) {  // read simultaneous
+    if (HAL_ADC_PollForConversion(&hadc2, 100) == HAL_OK && HAL_ADC_PollForConversion(&hadc1, 100) == HAL_OK) {  // timeout = 100ms
+      if (read1) mem.adc1 = HAL_ADC_GetValue(&hadc1);  // convert to 16bit
+      if (read2) mem.adc2 = HAL_ADC_GetValue(&hadc2);
     }
   }
-  if (need_disable_irq) __disable_irq();
+  if (masked) __disable_irq();  // the counter is still copied atomically, and enabled by its after hook
 }
-void my_after(void* softio, SoftIO_Head_t* head) {
-  uint8_t need_enable_irq = 0;
-  if (head->type == SOFTIO_HEAD_TYPE_WRITE) {
-    if (softio_is_variable_included(sio, *head, mem.gpio_out)) {
-      GPIOB->BSRR = mem.gpio_out | ( ((uint32_t)(~mem.gpio_out & 0x0ff))<<16 );  // atomic write
-    }
-    if (softio_is_variable_included(sio, *head, mem.led)) {
-      HAL_GPIO_WritePin(LED_GPIO_Port, LED_Pin, mem.led);
-    }
-    if (softio_is_variable_included(sio, *head, mem.tim1_prescaler)) TIM1->PSC = mem.tim1_prescaler;
-    if (softio_is_variable_included(sio, *head, mem.tim1_period)) TIM1->ARR = mem.tim1_period;
-    if (softio_is_variable_included(sio, *head, mem.tim1_pulse)) TIM1->CCR1 = mem.tim1_pulse;
-    if (softio_is_variable_included(sio, *head, mem.tim1_PWM)) {
-      if (mem.tim1_PWM) {
-        TIM1->CCER |= (uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // enable pwm1
-        TIM1->BDTR |= TIM_BDTR_MOE;  // only TIM1 needs this
-        TIM1->CR1 |= TIM_CR1_CEN;  // enable peripheral
-      } else {
-        TIM1->CCER &= ~(uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // disable pwm1
-      }
-    }
-    if (softio_is_variable_included(sio, *head, mem.tim1_IT)) {
-      if (mem.tim1_IT) {
-        TIM1->DIER |= TIM_IT_UPDATE;  // enable interrupt
-        TIM1->CR1 |= TIM_CR1_CEN;  // enable peripheral
-      } else {
-        TIM1->DIER &= ~TIM_IT_UPDATE;  // disable interrupt
-      }
-    }
-    if (softio_is_variable_included(sio, *head, mem.tim2_prescaler)) TIM2->PSC = mem.tim2_prescaler;
-    if (softio_is_variable_included(sio, *head, mem.tim2_period)) TIM2->ARR = mem.tim2_period;
-    if (softio_is_variable_included(sio, *head, mem.tim2_pulse)) TIM2->CCR1 = mem.tim2_pulse;
-    if (softio_is_variable_included(sio, *head, mem.tim2_PWM)) {
-      if (mem.tim2_PWM) {
-        TIM2->CCER |= (uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // enable pwm1
-        TIM2->CR1 |= TIM_CR1_CEN;  // enable peripheral
-      } else {
-        TIM2->CCER &= ~(uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // disable pwm1
-      }
-    }
-    if (softio_is_variable_included(sio, *head, mem.tim2_IT)) {
-      if (mem.tim2_IT) {
-        TIM2->DIER |= TIM_IT_UPDATE;  // enable interrupt
-        TIM2->CR1 |= TIM_CR1_CEN;  // enable peripheral
-      } else {
-        TIM2->DIER &= ~TIM_IT_UPDATE;  // disable interrupt
-      }
-    }
+void hook_read_adc1(void* softio, SoftIO_Head_t* head) {
+  adc_read_both(1, softio_is_variable_included(sio, *head, mem.adc2));
+}
+void hook_read_adc2(void* softio, SoftIO_Head_t* head) {
+  if (!softio_is_variable_included(sio, *head, mem.adc1)) adc_read_both(0, 1);  // otherwise done by hook_read_adc1
+}
+void hook_write_gpio_out(void* softio, SoftIO_Head_t* head) {
+  GPIOB->BSRR = mem.gpio_out | ( ((uint32_t)(~mem.gpio_out & 0x0ff))<<16 );  // atomic write
+}
+void hook_write_led(void* softio, SoftIO_Head_t* head) {
+  HAL_GPIO_WritePin(LED_GPIO_Port, LED_Pin, mem.led);
+}
+// enabling a timer applies its configuration itself: its hook is called before those of prescaler, period and pulse, which are behind it
+void hook_write_tim1_config(void* softio, SoftIO_Head_t* head) {
+  TIM1->PSC = mem.tim1_prescaler;
+  TIM1->ARR = mem.tim1_period;
+  TIM1->CCR1 = mem.tim1_pulse;
+}
+void hook_write_tim1_PWM(void* softio, SoftIO_Head_t* head) {
+  if (mem.tim1_PWM) {
+    hook_write_tim1_config(softio, head);
+    TIM1->CCER |= (uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // enable pwm1
+    TIM1->BDTR |= TIM_BDTR_MOE;  // only TIM1 needs this
+    TIM1->CR1 |= TIM_CR1_CEN;  // enable peripheral
+  } else {
+    TIM1->CCER &= ~(uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // disable pwm1
   }
-  if (head->type == SOFTIO_HEAD_TYPE_READ || head->type == SOFTIO_HEAD_TYPE_WRITE) {
-    if (softio_is_variable_included(sio, *head, mem.gpio_count)) {  // atomic write
-      need_enable_irq = 1;
-    }
-    if (softio_is_variable_included(sio, *head, mem.gpio_count_add)) {  // atomic write
-      need_enable_irq = 1;
-    }
-    if (softio_is_variable_included(sio, *head, mem.adc_count)) {  // atomic write
-      need_enable_irq = 1;
-    }
-    if (softio_is_variable_included(sio, *head, mem.adc_count_add)) {  // atomic write
-      need_enable_irq = 1;
-    }
+}
+void hook_write_tim1_IT(void* softio, SoftIO_Head_t* head) {
+  if (mem.tim1_IT) {
+    hook_write_tim1_config(softio, head);
+    TIM1->DIER |= TIM_IT_UPDATE;  // enable interrupt
+    TIM1->CR1 |= TIM_CR1_CEN;  // enable peripheral
+  } else {
+    TIM1->DIER &= ~TIM_IT_UPDATE;  // disable interrupt
+  }
+}
+void hook_write_tim2_config(void* softio, SoftIO_Head_t* head) {
+  TIM2->PSC = mem.tim2_prescaler;
+  TIM2->ARR = mem.tim2_period;
+  TIM2->CCR1 = mem.tim2_pulse;
+}
+void hook_write_tim2_PWM(void* softio, SoftIO_Head_t* head) {
+  if (mem.tim2_PWM) {
+    hook_write_tim2_config(softio, head);
+    TIM2->CCER |= (uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // enable pwm1
+    TIM2->CR1 |= TIM_CR1_CEN;  // enable peripheral
+  } else {
+    TIM2->CCER &= ~(uint32_t)(TIM_CCx_ENABLE << TIM_CHANNEL_1);  // disable pwm1
   }
-  if (need_enable_irq) __enable_irq();
+}
+void hook_write_tim2_IT(void* softio, SoftIO_Head_t* head) {
+  if (mem.tim2_IT) {
+    hook_write_tim2_config(softio, head);
+    TIM2->DIER |= TIM_IT_UPDATE;  // enable interrupt
+    TIM2->CR1 |= TIM_CR1_CEN;  // enable peripheral
+  } else {
+    TIM2->DIER &= ~TIM_IT_UPDATE;  // disable interrupt
+  }
+}
+void hook_init(void) {
+  softio_set_hooks(sio, hooks, sizeof(hooks) / sizeof(hooks[0]));
+  softio_hook(sio, mem.gpio_out, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_gpio_out);
+  softio_hook(sio, mem.gpio_in, SOFTIO_HOOK_ON_READ, hook_read_gpio_in, NULL);
+  softio_hook(sio, mem.gpio_count, SOFTIO_HOOK_ON_READ | SOFTIO_HOOK_ON_WRITE, hook_disable_irq, hook_enable_irq);
+  softio_hook(sio, mem.adc1, SOFTIO_HOOK_ON_READ, hook_read_adc1, NULL);
+  softio_hook(sio, mem.adc2, SOFTIO_HOOK_ON_READ, hook_read_adc2, NULL);
+  softio_hook(sio, mem.adc_count, SOFTIO_HOOK_ON_READ | SOFTIO_HOOK_ON_WRITE, hook_disable_irq, hook_enable_irq);
+  softio_hook(sio, mem.led, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_led);
+  softio_hook(sio, mem.tim1_PWM, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim1_PWM);
+  softio_hook(sio, mem.tim1_IT, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim1_IT);
+  softio_hook(sio, mem.tim1_prescaler, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim1_config);
+  softio_hook(sio, mem.tim1_period, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim1_config);
+  softio_hook(sio, mem.tim1_pulse, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim1_config);
+  softio_hook(sio, mem.tim2_PWM, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim2_PWM);
+  softio_hook(sio, mem.tim2_IT, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim2_IT);
+  softio_hook(sio, mem.tim2_prescaler, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim2_config);
+  softio_hook(sio, mem.tim2_period, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim2_config);
+  softio_hook(sio, mem.tim2_pulse, SOFTIO_HOOK_ON_WRITE, NULL, hook_write_tim2_config);
+}
+void my_lock(void) {  // atomic operations of host
+  __disable_irq();
+}
+void my_unlock(void) {
+  __enable_irq();
 }
 // this function should be called first adc1 then adc2
 uint8_t adc1_callback_ready = 0;
@@ -191,14 +219,14 @@ void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
     adc2_callback_ready = 1;
   }
   if (adc1_callback_ready && adc2_callback_ready) {
-    if (fifo_remain(&mem.fifo1) < 4) {
+    if (fifo1k_remain(&mem.fifo1) < (mem.adc_packed ? PACK12_PAIR_SIZE : 4)) {  // main loop drains it
       ++mem.adc_overflow;
+    } else if (mem.adc_packed) {
+      pack12_enque(&mem.fifo1, adc1_callback_val, adc2_callback_val);
     } else {
       // assert(adc1_callback_val < 4096 && adc2_callback_val < 4096);
-      fifo_enque(&mem.fifo1, adc1_callback_val);
-      fifo_enque(&mem.fifo1, adc1_callback_val >> 8);
-      fifo_enque(&mem.fifo1, adc2_callback_val);
-      fifo_enque(&mem.fifo1, adc2_callback_val >> 8);
+      char sample[4] = { (char)adc1_callback_val, (char)(adc1_callback_val >> 8), (char)adc2_callback_val, (char)(adc2_callback_val >> 8) };
+      fifo1k_put(&mem.fifo1, sample, 4);
     }
   }
 }
@@ -229,8 +257,11 @@ int main(void)
 
   /* USER CODE BEGIN SysInit */
   memory_init_user_code_begin_sys_init();
-  sio.before = my_before;
-	sio.after = my_after;
+  hook_init();
+  sio.tick = HAL_GetTick;  // periods of subscriptions are in ms
+  sio.ready = my_ready;
+  sio.lock = my_lock;
+  sio.unlock = my_unlock;
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
@@ -262,6 +293,7 @@ int main(void)
   /* USER CODE BEGIN WHILE */
   while (1)
   {
+    usb_fifo_receive();  // handle frames in the received packet in place
     softio_try_handle_all(sio);  // handle commands and return, non-blocking function
     usb_fifo_transmit();
     /* USER CODE END WHILE */
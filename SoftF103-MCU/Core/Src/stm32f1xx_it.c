@@ -261,10 +261,10 @@ void TIM1_UP_IRQHandler(void)
     TIM1->SR = ~TIM_IT_UPDATE;
     if (mem.gpio_count) {
       --mem.gpio_count;
-      if (fifo_empty(&mem.fifo0)) {
+      if (fifo1k_empty(&mem.fifo0)) {  // main loop fills it
         ++mem.gpio_underflow;
       } else {
-        uint8_t tmp = fifo_deque(&mem.fifo0);
+        uint8_t tmp = fifo1k_deque(&mem.fifo0);
         mem.gpio_out = tmp;
         GPIOB->BSRR = tmp | ( ((uint32_t)(~tmp & 0x0ff))<<16 );  // atomic write
       }
@@ -353,9 +353,9 @@ void USART2_IRQHandler(void)
 {
   /* USER CODE BEGIN USART2_IRQn 0 */
   if (USART2->SR & USART_SR_TXE) {  // transmit done, need to fetch from fifo?
-    if (!fifo_empty(&mem.logging)) {
+    if (!fifo_spsc_empty(&mem.logging)) {
       // write USART2->DR to send next byte
-      USART2->DR = fifo_deque(&mem.logging);
+      USART2->DR = fifo_spsc_deque(&mem.logging);
     } else {
       // if no more to send, close the interrupt
       USART2->CR1 &= ~USART_CR1_TXEIE;  // disable tx empty interrupt
@@ -140,6 +140,20 @@ void usb_fifo_transmit(void) {
 		if (i) CDC_Transmit_FS(UserTxBufferFS, i);  // print_debug("send %d byte", i);
   }
 }
+// packet left by CDC_Receive_FS, handled in place by main loop. endpoint is re-armed only after it's fully taken, so host is NAKed instead of dropping
+static uint8_t* volatile usb_rx_packet;
+static volatile uint32_t usb_rx_length;
+static uint32_t usb_rx_taken;
+void usb_fifo_receive(void) {
+	if (!usb_rx_length) return;
+	usb_rx_taken += softio_receive(sio, (char*)usb_rx_packet + usb_rx_taken, usb_rx_length - usb_rx_taken);
+	if (usb_rx_taken == usb_rx_length) {
+		usb_rx_taken = 0;
+		usb_rx_length = 0;
+		USBD_CDC_SetRxBuffer(&hUsbDeviceFS, usb_rx_packet);
+		USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+	}
+}
 
 /* USER CODE END PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -271,11 +285,14 @@ static int8_t CDC_Control_FS(uint8_t cmd, uint8_t* pbuf, uint16_t length)
 static int8_t CDC_Receive_FS(uint8_t* Buf, uint32_t *Len)
 {
   /* USER CODE BEGIN 6 */
-  uint32_t actually_received = fifo_copy_from_buffer(&mem.siorx, (char*)Buf, *Len);
-	mem.siorx_overflow += *Len - actually_received;
   // CDC_Transmit_FS(Buf, *Len);  // loop test
-  USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
-  USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+  if (*Len == 0) {  // nothing to handle, re-arm now
+    USBD_CDC_SetRxBuffer(&hUsbDeviceFS, &Buf[0]);
+    USBD_CDC_ReceivePacket(&hUsbDeviceFS);
+    return (USBD_OK);
+  }
+  usb_rx_packet = Buf;  // see usb_fifo_receive
+  usb_rx_length = *Len;
   return (USBD_OK);
   /* USER CODE END 6 */
 }
@@ -0,0 +1,70 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+
+// atomic read-modify-write (see SOFTIO_EXT_ATOMIC) against a simulated SoftF103 in process: every operation on 1, 2 and 4 byte words
+// returns the old value and leaves the new one in both memories, pipelined ones each get their own old value, slave changes the word
+// inside lock and unlock and its hooks see a write. without the feature host falls back to a read and a write
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+int failed = 0;
+int locked, unlocked, hooked;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	sim.sio.lock = []() { ++locked; };
+	sim.sio.unlock = []() { ++unlocked; };
+	softio_hook(sim.sio, sim.mem.gpio_count, SOFTIO_HOOK_ON_WRITE, NULL, [](void*, SoftIO_Head_t*) { ++hooked; });
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	CHECK(sio.features & SOFTIO_FEATURE_ATOMIC);
+
+	uint32_t old = 0;
+	sim.mem.gpio_count = 100;
+	softio_blocking(fetch_add, sio, mem.gpio_count, 23, &old);
+	CHECK(old == 100 && mem.gpio_count == 123 && sim.mem.gpio_count == 123);
+	CHECK(locked == 1 && unlocked == 1 && hooked == 1);
+	sim.mem.tim2_period = 0xFFF0;
+	softio_blocking(fetch_add, sio, mem.tim2_period, 0x20, &old);  // wraps in 16 bits
+	CHECK(old == 0xFFF0 && mem.tim2_period == 0x10 && sim.mem.tim2_period == 0x10);
+
+	// compare and swap, both ways
+	softio_blocking(cas, sio, mem.gpio_count, 123, 7, &old);
+	CHECK(old == 123 && sim.mem.gpio_count == 7 && mem.gpio_count == 7);
+	softio_blocking(cas, sio, mem.gpio_count, 123, 9, &old);
+	CHECK(old == 7 && sim.mem.gpio_count == 7 && mem.gpio_count == 7);
+
+	// bits of a byte
+	sim.mem.gpio_out = 0x0F;
+	softio_blocking(set_bits, sio, mem.gpio_out, 0x30, &old);
+	CHECK(old == 0x0F && sim.mem.gpio_out == 0x3F);
+	softio_blocking(clear_bits, sio, mem.gpio_out, 0x03, &old);
+	CHECK(old == 0x3F && sim.mem.gpio_out == 0x3C);
+	softio_blocking(write_masked, sio, mem.gpio_out, 0xF0, 0xA5, &old);
+	CHECK(old == 0x3C && sim.mem.gpio_out == 0xAC && mem.gpio_out == 0xAC);
+
+	// pipelined, each one has its own old value
+	uint32_t olds[100];
+	sim.mem.adc_count = 1000;
+	for (int i=0; i<100; ++i) softio_delay_fetch_add(sio, mem.adc_count, 1, &olds[i]);
+	softio_wait_delayed(sio);
+	int wrong = 0;
+	for (int i=0; i<100; ++i) if (olds[i] != 1000u + i) ++wrong;
+	CHECK(wrong == 0 && sim.mem.adc_count == 1100 && mem.adc_count == 1100);
+	CHECK(locked == unlocked);
+
+	// fallback of a remote without atomics
+	sio.features &= ~SOFTIO_FEATURE_ATOMIC;
+	locked = 0;
+	softio_blocking(fetch_add, sio, mem.adc_count, 5, &old);
+	CHECK(old == 1100 && sim.mem.adc_count == 1105 && mem.adc_count == 1105 && locked == 0);
+
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,85 @@
+#include "stdio.h"
+#define SOFTF103HOST_IMPLEMENTATION
+#include "softf103-ex.h"
+#include "softio-coro.h"
+
+// GPIO streaming, ADC monitoring and LED blinking at the same time, driven by a single thread
+
+SoftF103Host_t f103;
+SoftIO_Coro_t coro;
+bool streaming = true;
+
+SoftIO_Task_t gpio_streaming(float frequency, vector<uint8_t> samples) {
+	auto& mem = f103.mem;
+	mem.gpio_count = 0;
+	mem.gpio_underflow = 0;
+	float actual = f103.Timer_Set_IT(1, frequency);
+	softio_prog_init(f103.sio, f103.prog, mem.program_buf);
+	softio_prog_write_between(f103.sio, f103.prog, mem.gpio_count, mem.gpio_underflow);
+	softio_prog_reset_fifo(f103.sio, f103.prog, mem.fifo0);
+	softio_prog_write_between(f103.sio, f103.prog, mem.tim1_IT, mem.tim1_period);
+	softio_delay(upload, f103.sio, f103.prog);
+	softio_delay(run, f103.sio, f103.prog);
+	co_await coro.last();
+	fifo_clear(&mem.fifo0);
+	printf("GPIO streaming frequency: %f kHz\n", actual/1e3);
+	uint32_t written_cnt = 0;
+	while (written_cnt < samples.size() && !fifo_full(&mem.fifo0)) fifo_enque(&mem.fifo0, samples[written_cnt++]);
+	while (!fifo_empty(&mem.fifo0)) co_await coro.write_fifo(mem.fifo0);
+	mem.gpio_count = samples.size();
+	co_await coro.write(mem.gpio_count);  // start transmitting
+	while (written_cnt < samples.size()) {
+		uint32_t write_len = fifo_capacity(&mem.fifo0) + samples.size() - mem.gpio_count - written_cnt;  // maximum write without overflow
+		write_len = min(write_len, (uint32_t)(samples.size() - written_cnt));
+		for (uint32_t i=0; i<write_len; ++i) fifo_enque(&mem.fifo0, samples[written_cnt++]);
+		while (!fifo_empty(&mem.fifo0)) co_await coro.write_fifo(mem.fifo0);
+		co_await coro.read_between(mem.gpio_count, mem.gpio_underflow);
+		assert(mem.gpio_underflow == 0 && "tx underflow occurs, may be system overloaded or frequency too high");
+		if (!write_len) co_await coro.sleep(chrono::milliseconds(1));  // remote fifo is full, other coroutines run meanwhile
+	}
+	do {
+		co_await coro.sleep(chrono::milliseconds(10));
+		co_await coro.read(mem.gpio_count);
+	} while (mem.gpio_count);
+	printf("GPIO streaming done\n");
+	streaming = false;
+}
+
+SoftIO_Task_t adc_monitor() {
+	while (streaming) {
+		bool done = co_await coro.read_tagged(f103.mem.adc1);  // not in the condition of if, which gcc 12 miscompiles in a loop
+		if (done) printf("ADC1: %f V\n", 3.3 * f103.mem.adc1 / 4096.);
+		co_await coro.sleep(chrono::milliseconds(100));
+	}
+}
+
+SoftIO_Task_t blink() {
+	while (streaming) {
+		f103.mem.led = !f103.mem.led;
+		co_await coro.write(f103.mem.led);
+		co_await coro.sleep(chrono::milliseconds(200));
+	}
+}
+
+int main(int argc, char** argv) {
+	if (argc != 4) {
+		printf("usage: <portname> <frequency> <length>\n");
+		return -1;
+	}
+
+	f103.open(argv[1]);
+	float frequency = atof(argv[2]);
+	int length = atoi(argv[3]);
+	vector<uint8_t> samples(length);
+	for (int i=0; i<length; ++i) samples[i] = i;
+
+	coro.attach(f103.futures);
+	coro.spawn(gpio_streaming(frequency, samples));
+	coro.spawn(adc_monitor());
+	coro.spawn(blink());
+	coro.run();
+
+	f103.close();
+
+	return 0;
+}
@@ -0,0 +1,69 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+#include <vector>
+
+// credit flow control (see SOFTIO_EXT_CREDIT) against a simulated SoftF103 in process, over a link which drops what doesn't fit in
+// siorx like CDC_Receive_FS, with a slave which only runs while host waits. with credits nothing is dropped however fast host puts,
+// and the window could be deeper than SOFTIO_HEAD_LENGTH. without them the same stream overflows
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+int failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+void flood(int count) {  // posted writes of growing values
+	for (int i=0; i<count; ++i) {
+		mem.tim2_period = i;
+		mem.tim2_pulse = i * 3;
+		softio_delay_write_posted_between(sio, mem.tim2_period, mem.tim2_pulse);
+	}
+}
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	sio.puts = [&](char *buffer, size_t size)->size_t {  // taken at once, what doesn't fit is lost
+		uint32_t n = fifo_copy_from_buffer(&sim.mem.siorx, buffer, size);
+		sim.mem.siorx_overflow += size - n;
+		return size;
+	};
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	CHECK(sio.features & SOFTIO_FEATURE_CREDIT);
+
+	softio_blocking(credit, sio);
+	CHECK(sio.credit_capacity == fifo_capacity(&sim.mem.siorx));
+	std::vector<SoftIO_Trans_t> window(256);
+	softio_set_window(sio, window.data(), window.size());
+
+	// thousands of posted writes, the slave only runs when host waits for credits
+	flood(20000);
+	softio_delay_fence(sio);
+	softio_wait_delayed(sio);
+	CHECK(sim.mem.siorx_overflow == 0);
+	CHECK(sim.mem.tim2_period == 19999 && sim.mem.tim2_pulse == (uint16_t)(19999 * 3));
+
+	// more reads in flight than SOFTIO_HEAD_LENGTH, bounded by credits only
+	int deepest = 0;
+	for (int i=0; i<200; ++i) {
+		softio_delay_read(sio, mem.adc_overflow);
+		deepest = std::max(deepest, (sio.write + sio.length - sio.read) % sio.length);
+	}
+	softio_wait_delayed(sio);
+	CHECK(deepest >= SOFTIO_HEAD_LENGTH);
+	CHECK(sim.mem.siorx_overflow == 0);
+
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+
+	// without credits, host fills the link blindly
+	sio.credit_capacity = 0;
+	flood(2000);
+	softio_flush_fifo(sio, *sio.tx);
+	CHECK(sim.mem.siorx_overflow > 0);
+
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
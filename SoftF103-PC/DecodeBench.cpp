@@ -0,0 +1,116 @@
+#include "stdio.h"
+#include "softio.h"
+#include <chrono>
+
+// cost of host decoding a read reply (see __softio_try_handle_one) by length, against a byte-by-byte reference like the decoder used
+// to be: checksum by fifo_preread, then fifo_deque into memory. each request is issued and its bytes dropped from tx, in both of them.
+// then the checksum alone: __softio_sum (SSE2/AVX2 where compiled in) against the word-at-a-time path of MCU and a plain byte loop
+
+struct Mem_t {
+	char data[1024];
+	char rx_buf[1024];  // as siorx and siotx of SoftF103
+	char tx_buf[1024];
+	char stream_buf[1024];
+	Fifo_t rx;  // fifos are after rx, see softio_init
+	Fifo_t tx;
+	Fifo_t stream;
+} mem;
+SoftIO_t sio;
+volatile char sink;
+
+void bytewise(SoftIO_t* softio) {
+	SoftIO_Trans_t* rptr = &softio->transactions[softio->read];
+	uint32_t type = SOFTIO_HEAD_TYPE_RAW(fifo_preread(softio->rx, 0));
+	uint32_t length = (unsigned char)fifo_preread(softio->rx, 1);
+	char sum = fifo_preread(softio->rx, 2+length);
+	for (uint32_t i=0; i<length; ++i) sum += fifo_preread(softio->rx, 2+i);
+	assert(sum == 0 && "check sum failed for read");
+	fifo_deque(softio->rx); fifo_deque(softio->rx);  // get type and length
+	if (type == SOFTIO_HEAD_TYPE_READ) for (uint32_t i=0; i<length; ++i) softio->base[rptr->head.addr + i] = fifo_deque(softio->rx);
+	else for (uint32_t i=0; i<length; ++i) fifo_enque((Fifo_t*)(softio->base + rptr->head.addr), fifo_deque(softio->rx));
+	fifo_deque(softio->rx); // get checksum out of fifo
+	softio->read = (softio->read + 1) % softio->length;
+}
+
+double decode(bool span, uint32_t type, uint32_t length) {
+	const int rounds = 100000;
+	char frame[3 + 256];
+	frame[0] = type | 0x01;
+	frame[1] = length;
+	char sum = 0;
+	for (uint32_t i=0; i<length; ++i) sum += frame[2 + i] = (char)(i * 13 + 1);
+	frame[2 + length] = -sum;
+	auto start = std::chrono::steady_clock::now();
+	for (int r=0; r<rounds; ++r) {
+		if (type == SOFTIO_HEAD_TYPE_READ) __softio_delay_read(&sio, mem.data, length);
+		else __softio_delay_read_fifo(&sio, &mem.stream, length);
+		fifo_skip(&mem.tx, fifo_count(&mem.tx));
+		fifo_copy_from_buffer(&mem.rx, frame, 3 + length);
+		if (span) __softio_try_handle_one(&sio);
+		else bytewise(&sio);
+		if (type == SOFTIO_HEAD_TYPE_READ_FIFO) fifo_skip(&mem.stream, fifo_count(&mem.stream));
+	}
+	assert(fifo_empty(&mem.rx) && sio.read == sio.write && sio.errors == 0);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / rounds * 1e9;
+}
+
+char sum_words(const char* buf, uint32_t length) {  // __softio_sum without SIMD
+	uint32_t sum = 0;
+	while (length >= 4) {
+		uint32_t acc = 0;
+		uint32_t words = length / 4 > 128 ? 128 : length / 4;
+		for (uint32_t i=0; i<words; ++i) {
+			uint32_t w; memcpy(&w, buf, 4); buf += 4;
+			acc += (w & 0x00FF00FF) + ((w >> 8) & 0x00FF00FF);
+		}
+		sum += (acc & 0xFFFF) + (acc >> 16);
+		length -= words * 4;
+	}
+	while (length--) sum += (unsigned char)*buf++;
+	return (char)sum;
+}
+char sum_bytes(const char* buf, uint32_t length) {
+	char sum = 0;
+	for (uint32_t i=0; i<length; ++i) sum += buf[i];
+	return sum;
+}
+double checksum(char (*sum)(const char*, uint32_t), uint32_t length) {
+	const int rounds = 1000000;
+	auto start = std::chrono::steady_clock::now();
+	for (int r=0; r<rounds; ++r) sink = sum(mem.data + (r & 7), length);  // misaligned too
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / rounds * 1e9;
+}
+
+int main() {
+	fifo_init(&mem.rx, mem.rx_buf, sizeof(mem.rx_buf));
+	fifo_init(&mem.tx, mem.tx_buf, sizeof(mem.tx_buf));
+	fifo_init(&mem.stream, mem.stream_buf, sizeof(mem.stream_buf));
+	softio_init(&sio, &mem, sizeof(mem), &mem.rx, &mem.tx);
+	uint32_t lengths[4] = { 16, 64, 128, 254 };
+	for (int t=0; t<2; ++t) {
+		uint32_t type = t ? SOFTIO_HEAD_TYPE_READ_FIFO : SOFTIO_HEAD_TYPE_READ;
+		for (int l=0; l<4; ++l) {
+			double span = decode(true, type, lengths[l]);
+			double byte = decode(false, type, lengths[l]);
+			printf("%-9s %3u bytes: span %6.1f ns, bytewise %7.1f ns per reply\n", t ? "read_fifo" : "read", lengths[l], span, byte);
+		}
+	}
+#if defined(__AVX2__)
+	const char* simd = "avx2";
+#elif defined(__SSE2__)
+	const char* simd = "sse2";
+#else
+	const char* simd = "none";
+#endif
+	for (int i=0; i<1000; ++i) mem.data[i] = (char)(i * 7 + 3);
+	uint32_t sums[4] = { 16, 64, 254, 1000 };
+	for (int l=0; l<4; ++l) {
+		if (__softio_sum(mem.data + 1, sums[l]) != sum_bytes(mem.data + 1, sums[l]) || sum_words(mem.data + 1, sums[l]) != sum_bytes(mem.data + 1, sums[l])) {
+			printf("checksum of %u bytes differs\n", sums[l]);
+			return 1;
+		}
+		printf("checksum %4u bytes: __softio_sum (simd %s) %6.1f ns, words %6.1f ns, bytes %6.1f ns\n", sums[l], simd,
+			checksum(__softio_sum, sums[l]), checksum(sum_words, sums[l]), checksum(sum_bytes, sums[l]));
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+#include <string>
+
+// fifo subscriptions (see SOFTIO_SUB_FIFO) against a simulated SoftF103 in process: slave drains a stream fifo into pushes by itself,
+// host gets the stream in order into its local fifo without a single request, pushes are at most the subscribed length, and a
+// partial one comes after the period
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+int failed = 0;
+std::string received;
+int pushes;
+uint32_t largest;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	CHECK(sio.features & SOFTIO_FEATURE_PUSH);
+	sio.subs[0].callback = [](void*, uint32_t) {
+		uint32_t n = fifo_count(&mem.fifo0);
+		largest = std::max(largest, n);
+		std::string data(n, 0);
+		fifo_move_to_buffer(&data[0], &mem.fifo0, n);
+		received += data;
+		++pushes;
+	};
+	softio_delay_subscribe_fifo(sio, 0, mem.fifo0, 252, 2);
+	softio_wait_delayed(sio);
+	uint32_t handled = sim.sio.handled;
+
+	// slave side produces whenever there is room, like an interrupt
+	std::string stream(20000, 0);
+	for (size_t i=0; i<stream.size(); ++i) stream[i] = (char)(i * 7 + i / 256);
+	size_t produced = 0;
+	for (int frames = 0; frames < 100000 && received.size() < stream.size(); ++frames) {
+		produced += fifo_copy_from_buffer(&sim.mem.fifo0, &stream[produced], stream.size() - produced);
+		softio_wait_frame(sio);
+	}
+	CHECK(received == stream);
+	CHECK(largest <= 252 && pushes >= (int)(stream.size() / 252));
+	CHECK(sim.sio.handled == handled);  // no request
+
+	// a partial push, after the period
+	pushes = 0;
+	received.clear();
+	fifo_copy_from_buffer(&sim.mem.fifo0, "partial", 7);
+	for (int frames = 0; frames < 1000 && received.size() < 7; ++frames) softio_wait_frame(sio);
+	CHECK(received == "partial" && pushes == 1);
+
+	softio_delay_unsubscribe(sio, 0);
+	softio_wait_delayed(sio);
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
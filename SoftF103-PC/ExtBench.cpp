@@ -0,0 +1,56 @@
+#include "stdio.h"
+#define SOFTIO_USE_FUNCTION
+#include "softf103.h"
+#include "serial/serial.h"
+#include <chrono>
+#include <vector>
+#include <stdlib.h>
+
+// throughput of bulk reads and writes with extended frames, against the legacy split into 254 byte requests (as with a slave
+// without SOFTIO_FEATURE_EXTEND). blocks are logging_buf to fifo1_buf, 2560 bytes, e.g. `Simulator ./ExtBench @` (see Simulator.cpp)
+
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+
+double bench(bool write, int rounds) {
+	uint32_t length = (char*)(&mem.fifo1_buf[1024]) - mem.logging_buf;
+	auto start = std::chrono::steady_clock::now();
+	for (int r=0; r<rounds; ++r) {
+		if (write) __softio_delay_write(&sio, mem.logging_buf, length);
+		else __softio_delay_read(&sio, mem.logging_buf, length);
+	}
+	softio_wait_delayed(sio);
+	return (double)length * rounds / std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / 1e6;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 2 && argc != 3) {
+		printf("usage: <portname> [rounds]\n");
+		return -1;
+	}
+	int rounds = argc > 2 ? atoi(argv[2]) : 2000;
+	serial::Serial com(argv[1], 115200, serial::Timeout::simpleTimeout(1000));
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sio.gets = [&](char *buffer, size_t size)->size_t { return com.read((uint8_t*)buffer, size); };
+	sio.puts = [&](char *buffer, size_t size)->size_t { return com.write((uint8_t*)buffer, size); };
+	sio.available = [&]()->size_t { return com.available(); };
+
+	// handshake like SoftF103Host_t::open
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	assert(mem.version == MCU_VERSION && "version not match");
+	uint32_t features = mem.softio_features & SOFTIO_FEATURES;
+	if (!(features & SOFTIO_FEATURE_EXTEND)) printf("device has no extended frames, both runs are split\n");
+	sio.features = features;
+	softio_blocking(credit, sio);
+	std::vector<SoftIO_Trans_t> window(256);
+	if (sio.credit_capacity) softio_set_window(sio, window.data(), window.size());
+
+	for (int write=1; write>=0; --write) {
+		sio.features = features & ~SOFTIO_FEATURE_EXTEND;
+		double split = bench(write, rounds);
+		sio.features = features;
+		double extended = bench(write, rounds);
+		printf("%-5s: split %5.1f MB/s, extended %5.1f MB/s\n", write ? "write" : "read", split, extended);
+	}
+	return 0;
+}
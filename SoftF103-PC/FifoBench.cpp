@@ -0,0 +1,41 @@
+#include "stdio.h"
+#include "fifo.h"
+#include <chrono>
+
+// cost of a byte through a fifo of 1kB like fifo0 and fifo1 of SoftF103: enque, count and deque by the spsc functions on a fifo by
+// fifo_init (modulo), on one by fifo_init_pow2 (mask, flag checked on each call), and by fifo1k_xxx of FIFO_POW2_FUNCTIONS (mask only)
+
+FIFO_POW2_FUNCTIONS(fifo1k, 1024)
+
+// buffers next to fifos, within reach on 64-bit (see fifo_in_reach)
+char modulo_buf[1024], pow2_buf[1024], fixed_buf[1024];
+Fifo_t modulo, pow2, fixed;
+
+template <typename Enque, typename Deque, typename Count>
+double run(Fifo_t* fifo, Enque enque, Deque deque, Count count) {
+	const long rounds = 50000000;
+	volatile uint32_t sink;
+	uint32_t sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (long r=0; r<rounds; ++r) {
+		enque(fifo, (char)r);
+		sum += count(fifo);
+		sum += (unsigned char)deque(fifo);
+	}
+	sink = sum;
+	(void)sink;
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / rounds * 1e9;
+}
+
+int main() {
+	fifo_init(&modulo, modulo_buf, sizeof(modulo_buf));
+	fifo_init_pow2(&pow2, pow2_buf, sizeof(pow2_buf));
+	fifo_init_pow2(&fixed, fixed_buf, sizeof(fixed_buf));
+	for (int k=0; k<2; ++k) {  // the first round warms up
+		double t_modulo = run(&modulo, fifo_spsc_enque, fifo_spsc_deque, fifo_spsc_count);
+		double t_pow2 = run(&pow2, fifo_spsc_enque, fifo_spsc_deque, fifo_spsc_count);
+		double t_fixed = run(&fixed, fifo1k_enque, fifo1k_deque, fifo1k_count);
+		printf("enque + count + deque: modulo %.2f ns, pow2 %.2f ns, fifo1k %.2f ns\n", t_modulo, t_pow2, t_fixed);
+	}
+	return 0;
+}
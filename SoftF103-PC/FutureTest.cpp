@@ -0,0 +1,111 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+#include "softio-future.h"
+#include <vector>
+
+// futures (see softio-future.h) against a simulated SoftF103 in process: a future completes with its reply and its thens run in the
+// order of the window, the callback of softio before attach is still called, a tagged read's future completes out of order, and
+// futures of transactions dropped by resync, or by drop_all, complete as lost while the others complete with the right data
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+SoftIO_Futures_t futures;
+int failed = 0;
+bool converted;  // the slow "conversion" of adc1 is done
+int chained;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	uint32_t adc1 = (char*)&sim.mem.adc1 - (char*)&sim.mem;
+	sim.sio.ready = [adc1](void*, SoftIO_Head_t* head)->int { return head->addr != adc1 || converted; };
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	sio.callback = [](void*, SoftIO_Head_t*) { ++chained; };
+	futures.attach(sio);
+
+	// a single read
+	mem.pid = 0;
+	SoftIO_Future_t f = futures.read(mem.pid);
+	CHECK(!f.ready());
+	CHECK(f.wait() && f.done() && mem.pid == MCU_PID);
+	CHECK(chained == 1);
+	bool called = false;
+	f.then([&](bool done) { called = done; });  // at once, it's ready
+	CHECK(called);
+
+	// thens run in order, each with the data of its own reply. bytes of program_buf since local memory is overwritten by replies
+	// handled while waiting for a slot of the window
+	std::vector<int> order;
+	std::vector<SoftIO_Future_t> fs;
+	int wrong = 0;
+	for (int i=0; i<100; ++i) {
+		mem.program_buf[i] = i + 1;
+		fs.push_back(futures.write(mem.program_buf[i]));
+	}
+	memset(mem.program_buf, 0, 100);
+	for (int i=0; i<100; ++i) {
+		fs.push_back(futures.read(mem.program_buf[i]));
+		fs.back().then([&order, &wrong, i](bool done) {
+			if (!done || mem.program_buf[i] != i + 1 || (i < 99 && mem.program_buf[i + 1])) ++wrong;
+			order.push_back(i);
+		});
+	}
+	CHECK(!fs.back().ready());
+	CHECK(fs.back().wait());
+	int done = 0;
+	for (auto& x : fs) if (x.done()) ++done;
+	CHECK(done == 200 && wrong == 0 && order.size() == 100);
+	for (size_t i=0; i<order.size(); ++i) if (order[i] != (int)i) ++wrong;
+	CHECK(wrong == 0);
+
+	// a tagged read deferred by slave, a later one completes first
+	SoftIO_Future_t slow = futures.read_tagged(mem.adc1);
+	SoftIO_Future_t fast = futures.read(mem.pid);
+	CHECK(fast.wait() && !slow.ready());
+	converted = true;
+	CHECK(slow.wait() && mem.adc1 == sim.mem.adc1);
+
+	// remote is gone
+	converted = false;
+	slow = futures.read_tagged(mem.adc1);
+	futures.drop_all();
+	CHECK(slow.ready() && !slow.done() && !slow.wait());
+	converted = true;
+	softio_wait_all(sio);  // the reply is taken, without a future
+
+	// corrupt frames, multi reads aren't sent again by resync so some are lost, others are replied right
+	SoftIO_Region_t regions[2] = { SOFTIO_REGION(mem.version), SOFTIO_REGION(mem.pid) };
+	uint16_t lost = sio.lost;
+	sim.corrupt = 500;
+	fs.clear();
+	for (int i=0; i<2000; ++i) {
+		softio_delay_read_multi(sio, regions, 2);
+		fs.push_back(futures.last());
+		fs.back().then([&wrong](bool replied) {  // lost ones before a reply complete just before it
+			if (!replied) return;
+			if (mem.version != MCU_VERSION || mem.pid != MCU_PID) ++wrong;
+			mem.version = 0;
+			mem.pid = 0;
+		});
+	}
+	fs.back().wait();  // completes the trailing lost ones too, softio_wait_all leaves them to poll
+	sim.corrupt = 0;
+	int dropped = 0;
+	done = 0;
+	for (auto& x : fs) {
+		if (!x.ready()) continue;
+		if (x.done()) ++done;
+		else ++dropped;
+	}
+	printf("%d multi reads, %d lost, %u dropped by resync, %d wrong\n", done + dropped, dropped, (uint16_t)(sio.lost - lost), wrong);
+	CHECK(done + dropped == 2000 && dropped > 0 && dropped == (uint16_t)(sio.lost - lost));
+	CHECK(wrong <= 2);  // a flipped bit of a head isn't detected, see SOFTIO_CHECK
+
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
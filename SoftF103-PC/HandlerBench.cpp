@@ -0,0 +1,112 @@
+#include "stdio.h"
+#include "softio.h"
+#include <chrono>
+
+// cost of the slave handling a request (see __softio_try_handle_one) by payload length, against a byte-by-byte reference like the
+// handler used to be: every byte goes through fifo_enque/fifo_deque/fifo_preread and is added to the checksum on its own.
+// each request is copied into rx and its reply is dropped from tx, in both of them
+
+struct Mem_t {
+	char data[256];
+	char rx_buf[1024];  // as siorx and siotx of SoftF103
+	char tx_buf[1024];
+	char stream_buf[1024];
+	Fifo_t rx;  // fifos are after rx, see softio_init
+	Fifo_t tx;
+	Fifo_t stream;
+} mem;
+SoftIO_t sio;
+
+void head_bytewise(Fifo_t* rx, SoftIO_Head_t* head) {
+	char* buf = (char*)(void*)head;
+	for (size_t i=0; i < sizeof(SoftIO_Head_t); ++i) buf[i] = fifo_preread(rx, i);
+	for (size_t i=0; i < sizeof(SoftIO_Head_t); ++i) buf[i] = fifo_deque(rx);
+}
+void bytewise(SoftIO_t* softio) {
+	SoftIO_Head_t head;
+	head_bytewise(softio->rx, &head);
+	Fifo_t* fptr = (Fifo_t*)(softio->base + head.addr);
+	uint32_t length = head.length;
+	char sum = 0;
+	switch (head.type) {
+	case SOFTIO_HEAD_TYPE_READ:
+		fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_READ | 0x01));
+		fifo_enque(softio->tx, head.length);
+		for (uint32_t i=0; i<head.length; ++i) {
+			sum += softio->base[head.addr + i];
+			fifo_enque(softio->tx, softio->base[head.addr + i]);
+		}
+		fifo_enque(softio->tx, -sum);
+		break;
+	case SOFTIO_HEAD_TYPE_WRITE:
+		for (uint32_t i=0; i<(uint32_t)(head.length + 1); ++i) sum += fifo_preread(softio->rx, i);
+		assert(sum == 0 && "check sum failed for write");
+		for (uint32_t i=0; i<head.length; ++i) softio->base[head.addr + i] = fifo_deque(softio->rx);
+		fifo_deque(softio->rx);
+		fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_WRITE | 0x01));
+		fifo_enque(softio->tx, head.length);
+		break;
+	case SOFTIO_HEAD_TYPE_READ_FIFO:
+		if (length > fifo_count(fptr)) length = fifo_count(fptr);
+		fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_READ_FIFO | 0x01));
+		fifo_enque(softio->tx, length);
+		for (uint32_t i=0; i<length; ++i) {
+			char a = fifo_deque(fptr); sum += a;
+			fifo_enque(softio->tx, a);
+		}
+		fifo_enque(softio->tx, -sum);
+		break;
+	case SOFTIO_HEAD_TYPE_WRITE_FIFO:
+		for (uint32_t i=0; i<(uint32_t)(head.length + 1); ++i) sum += fifo_preread(softio->rx, i);
+		assert(sum == 0 && "check sum failed for write");
+		for (uint32_t i=0; i<length; ++i) fifo_enque(fptr, fifo_deque(softio->rx));
+		fifo_deque(softio->rx);
+		fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_WRITE_FIFO | 0x01));
+		fifo_enque(softio->tx, length);
+		break;
+	}
+}
+
+double handle(bool span, const char* frame, uint32_t size, uint32_t type, uint32_t length) {
+	const int rounds = 100000;
+	auto start = std::chrono::steady_clock::now();
+	for (int r=0; r<rounds; ++r) {
+		fifo_copy_from_buffer(&mem.rx, frame, size);
+		if (type == SOFTIO_HEAD_TYPE_READ_FIFO) fifo_write_commit(&mem.stream, length);  // samples of the stream, contents don't matter
+		if (span) __softio_try_handle_one(&sio);
+		else bytewise(&sio);
+		fifo_skip(&mem.tx, fifo_count(&mem.tx));
+		if (type == SOFTIO_HEAD_TYPE_WRITE_FIFO) fifo_skip(&mem.stream, fifo_count(&mem.stream));
+	}
+	assert(fifo_empty(&mem.rx) && sio.errors == 0);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / rounds * 1e9;
+}
+
+int main() {
+	fifo_init(&mem.rx, mem.rx_buf, sizeof(mem.rx_buf));
+	fifo_init(&mem.tx, mem.tx_buf, sizeof(mem.tx_buf));
+	fifo_init(&mem.stream, mem.stream_buf, sizeof(mem.stream_buf));
+	softio_init(&sio, &mem, sizeof(mem), &mem.rx, &mem.tx);
+	for (int i=0; i<256; ++i) mem.data[i] = (char)(i * 7 + 3);
+	uint32_t types[4] = { SOFTIO_HEAD_TYPE_READ, SOFTIO_HEAD_TYPE_WRITE, SOFTIO_HEAD_TYPE_READ_FIFO, SOFTIO_HEAD_TYPE_WRITE_FIFO };
+	const char* names[4] = { "read", "write", "read_fifo", "write_fifo" };
+	uint32_t lengths[5] = { 1, 16, 64, 128, 254 };
+	for (int t=0; t<4; ++t) {
+		for (int l=0; l<5; ++l) {
+			bool fifo = types[t] == SOFTIO_HEAD_TYPE_READ_FIFO || types[t] == SOFTIO_HEAD_TYPE_WRITE_FIFO;
+			SoftIO_Head_t head = { types[t], (uint32_t)(fifo ? (char*)&mem.stream - (char*)&mem : 0), lengths[l] };
+			char frame[4 + 256];
+			uint32_t size = 4;
+			memcpy(frame, &head, 4);
+			if (types[t] == SOFTIO_HEAD_TYPE_WRITE || types[t] == SOFTIO_HEAD_TYPE_WRITE_FIFO) {  // data and checksum follow
+				char sum = 0;
+				for (uint32_t i=0; i<lengths[l]; ++i) sum += frame[size++] = (char)(i * 13 + 1);
+				frame[size++] = -sum;
+			}
+			double span = handle(true, frame, size, types[t], lengths[l]);
+			double byte = handle(false, frame, size, types[t], lengths[l]);
+			printf("%-10s %3u bytes: span %6.1f ns, bytewise %7.1f ns per request\n", names[t], lengths[l], span, byte);
+		}
+	}
+	return 0;
+}
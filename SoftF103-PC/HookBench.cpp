@@ -0,0 +1,78 @@
+#include "stdio.h"
+#include "softio.h"
+#include <chrono>
+
+// cost of hook dispatch per request: the registry (see softio_set_hooks) against a chain of softio_is_variable_included in a global
+// before and after, like my_before and my_after of MCU used to be. every field has a hook, and a request includes few of them
+
+#define FIELDS 512
+struct Mem_t {
+	uint32_t field[FIELDS];
+	char rx_buf[256];
+	char tx_buf[256];
+	Fifo_t rx;
+	Fifo_t tx;
+} mem;
+SoftIO_t sio;
+SoftIO_Hook_t hooks[FIELDS];
+volatile uint32_t hits;
+int registered;  // fields with a hook, evenly spread
+
+void hook(void* softio, SoftIO_Head_t* head) {
+	(void)softio;
+	(void)head;
+	hits = hits + 1;
+}
+void chain(void* softio, SoftIO_Head_t* head) {
+	(void)softio;
+	if (head->type != SOFTIO_HEAD_TYPE_READ && head->type != SOFTIO_HEAD_TYPE_WRITE) return;
+	for (int i=0; i<registered; ++i) if (softio_is_variable_included(sio, *head, mem.field[i * FIELDS / registered])) hits = hits + 1;
+}
+
+double dispatch(SoftIO_Head_t head, uint32_t* hit) {
+	const int rounds = 200000;
+	hits = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int r=0; r<rounds; ++r) {
+		SoftIO_Head_t h = head;
+		__softio_before(&sio, &h);
+		__softio_after(&sio, &h);
+	}
+	*hit = hits;
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / rounds * 1e9;
+}
+
+int main() {
+	fifo_init(&mem.rx, mem.rx_buf, sizeof(mem.rx_buf));
+	fifo_init(&mem.tx, mem.tx_buf, sizeof(mem.tx_buf));
+	softio_init(&sio, &mem, sizeof(mem), &mem.rx, &mem.tx);
+	SoftIO_Head_t heads[3] = {
+		{ SOFTIO_HEAD_TYPE_WRITE, 4 * 300, 4 },
+		{ SOFTIO_HEAD_TYPE_READ, 4 * 100, 64 },
+		{ SOFTIO_HEAD_TYPE_READ_FIFO, (uint32_t)((char*)&mem.rx - (char*)&mem), 200 },
+	};
+	const char* names[3] = { "4 byte write", "64 byte read", "fifo read" };
+	int counts[3] = { 20, 100, FIELDS };
+	for (int c=0; c<3; ++c) {
+		registered = counts[c];
+		softio_set_hooks(sio, hooks, FIELDS);
+		for (int i=0; i<registered; ++i) softio_hook(sio, mem.field[i * FIELDS / registered], SOFTIO_HOOK_ON_READ | SOFTIO_HOOK_ON_WRITE, hook, hook);
+		uint32_t hook_count = sio.hook_count, hook_types = sio.hook_types;
+		for (int h=0; h<3; ++h) {
+			uint32_t hit_registry, hit_chain;
+			sio.before = NULL;
+			sio.after = NULL;
+			sio.hook_count = hook_count;
+			sio.hook_types = hook_types;
+			double registry = dispatch(heads[h], &hit_registry);
+			sio.before = chain;
+			sio.after = chain;
+			sio.hook_count = 0;
+			sio.hook_types = 0;
+			double linear = dispatch(heads[h], &hit_chain);
+			printf("%3d fields, %-12s: registry %6.1f ns, chain %7.1f ns per request (%s)\n", registered, names[h], registry, linear,
+				hit_registry == hit_chain ? "same hooks called" : "DIFFERENT HOOKS CALLED");
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+#include <vector>
+
+// a host talks to a simulated SoftF103 (see softf103-sim.h) in process: what host puts is cut into USB packets and handled in place
+// by the slave (see softio_receive), so frames straddle packets. extended, posted, multi, fifo and atomic requests are pipelined
+// with credit flow control, and both memories must agree
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+int failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+
+	// handshake like SoftF103Host_t::open
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	CHECK(mem.version == MCU_VERSION && mem.mem_size == sizeof(mem));
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	softio_blocking(credit, sio);
+	CHECK(sio.credit_capacity == fifo_capacity(&sim.mem.siorx));
+	std::vector<SoftIO_Trans_t> window(256);
+	softio_set_window(sio, window.data(), window.size());
+
+	// extended write and read, larger than a packet and than a basic frame
+	for (int i=0; i<1000; ++i) mem.fifo1_buf[i] = (char)(i * 13 + 5);
+	__softio_delay_write(&sio, mem.fifo1_buf, 1000);
+	softio_wait_delayed(sio);
+	CHECK(memcmp(sim.mem.fifo1_buf, mem.fifo1_buf, 1000) == 0);
+	for (int i=0; i<1000; ++i) sim.mem.fifo1_buf[i] = (char)(i * 7);
+	__softio_delay_read(&sio, mem.fifo1_buf, 1000);
+	softio_wait_delayed(sio);
+	CHECK(memcmp(sim.mem.fifo1_buf, mem.fifo1_buf, 1000) == 0);
+
+	// many small requests in flight, posted writes and a fence
+	for (int i=0; i<200; ++i) {
+		mem.tim2_period = i;
+		softio_delay_write(sio, mem.tim2_period);
+		softio_delay_read(sio, mem.adc1);
+		mem.led = i & 1;
+		softio_delay_write_posted(sio, mem.led);
+	}
+	softio_delay_fence(sio);
+	softio_wait_delayed(sio);
+	CHECK(sim.mem.tim2_period == 199 && sim.mem.led == 1);
+
+	// multi read, with hooks on regions
+	mem.gpio_out = 0x5A;
+	softio_blocking(write, sio, mem.gpio_out);
+	SoftIO_Region_t regions[3] = { SOFTIO_REGION(mem.pid), SOFTIO_REGION(mem.gpio_in), SOFTIO_REGION(mem.tim2_period) };
+	mem.pid = 0;
+	mem.tim2_period = 0;
+	softio_blocking(read_multi, sio, regions, 3);
+	CHECK(mem.pid == MCU_PID && mem.gpio_in == 0x5A && mem.tim2_period == 199);
+
+	// fifo write
+	char samples[600];
+	for (int i=0; i<600; ++i) samples[i] = (char)(i * 3);
+	fifo_copy_from_buffer(&mem.fifo0, samples, sizeof(samples));
+	while (!fifo_empty(&mem.fifo0)) softio_blocking(write_fifo, sio, mem.fifo0);
+	char received[600];
+	CHECK(fifo_move_to_buffer(received, &sim.mem.fifo0, sizeof(received)) == sizeof(received) && memcmp(samples, received, sizeof(samples)) == 0);
+
+	// atomic
+	sim.mem.adc_overflow = 3;
+	uint32_t old = 0;
+	softio_blocking(fetch_add, sio, mem.adc_overflow, 7, &old);
+	CHECK(old == 3 && mem.adc_overflow == 10 && sim.mem.adc_overflow == 10);
+
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+	if (sio.errors || sim.sio.errors) printf("errors: host %u (%s), slave %u (%s)\n", sio.errors, sio.error ? sio.error : "", sim.sio.errors,
+		sim.sio.error ? sim.sio.error : "");
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
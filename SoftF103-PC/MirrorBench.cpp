@@ -0,0 +1,103 @@
+#include "stdio.h"
+#include "softio.h"
+#include "softio-mirror.h"
+
+// receive throughput of a byte stream fed through a pty, with rx of 1kB as SoftF103, 64kB, or 64kB mirror mapped (see softio-mirror.h).
+// frames are [length][data][checksum] and handled like replies of softio: checksum in place, data copied out
+
+#ifdef __linux__
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <thread>
+#include <chrono>
+#include <vector>
+
+struct Rx_t {
+	Fifo_t fifo;
+	char buf[1 << 16];
+} rx;
+SoftIO_Mirror_t mirror;
+
+void bench(const char* name, int master, const std::vector<char>& stream, size_t total) {
+	tcflush(master, TCIOFLUSH);
+	int slave = ::open(ptsname(master), O_RDWR | O_NOCTTY);
+	struct termios raw;
+	tcgetattr(slave, &raw);
+	cfmakeraw(&raw);
+	tcsetattr(slave, TCSANOW, &raw);
+	std::thread writer([&]() {
+		for (size_t sent = 0; sent < total; sent += stream.size()) {
+			for (size_t i = 0; i < stream.size(); ) {
+				ssize_t n = write(master, stream.data() + i, stream.size() - i);
+				if (n > 0) i += n;
+			}
+		}
+	});
+	char data[256];
+	size_t bytes = 0, calls = 0, splits = 0, frames = 0, bad = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (bytes < total) {
+		Fifo_Spans_t spans;  // like __softio_gets_fifo_blocking, the first span is filled by one call
+		fifo_write_spans(&rx.fifo, &spans, fifo_remain(&rx.fifo));
+		ssize_t n = read(slave, spans.ptr[0], spans.len[0]);
+		if (n <= 0) continue;
+		fifo_write_commit(&rx.fifo, n);
+		++calls;
+		if (spans.len[1]) ++splits;  // more space behind the wrap around
+		uint32_t length;
+		while (!fifo_empty(&rx.fifo) && fifo_count(&rx.fifo) >= 2 + (length = (unsigned char)fifo_preread(&rx.fifo, 0))) {
+			bad += __softio_fifo_sum(&rx.fifo, 1, length + 1) != 0;
+			fifo_skip(&rx.fifo, 1);
+			fifo_move_to_buffer(data, &rx.fifo, length);
+			fifo_skip(&rx.fifo, 1);
+			bytes += length + 2;
+			++frames;
+		}
+	}
+	double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	writer.join();
+	::close(slave);
+	printf("%-12s %8.1f MB/s, %zu frames (%zu bad), %zu reads (%zu with free space split at wrap around)\n", name, bytes / t / 1e6, frames, bad, calls, splits);
+}
+
+int main(int argc, char** argv) {
+	if (argc > 2) {
+		printf("usage: [megabytes]\n");
+		return -1;
+	}
+	size_t total = (argc == 2 ? atoi(argv[1]) : 256) << 20;
+	std::vector<char> stream;  // frames of 1 to 254 bytes
+	for (int i = 0; stream.size() < (1 << 20); ++i) {
+		int length = (i * 37) % 254 + 1;
+		char sum = 0;
+		stream.push_back(length);
+		for (int j = 0; j < length; ++j) {
+			stream.push_back(i + j);
+			sum += (char)(i + j);
+		}
+		stream.push_back(-sum);
+	}
+	total = total / stream.size() * stream.size();
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	grantpt(master);
+	unlockpt(master);
+
+	fifo_init(&rx.fifo, rx.buf, 1024);
+	bench("1kB", master, stream, total);
+	fifo_init_pow2(&rx.fifo, rx.buf, sizeof(rx.buf));
+	bench("64kB", master, stream, total);
+	if (mirror.map(&rx.fifo, sizeof(rx.buf))) bench("64kB mirror", master, stream, total);
+	else printf("mirror mapped buffer not supported\n");
+
+	::close(master);
+	return 0;
+}
+
+#else
+int main() {
+	printf("mirror mapped buffer is only supported on Linux\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,64 @@
+#include "stdio.h"
+#include "pack12.h"
+#include <stdlib.h>
+#include <vector>
+
+// 12bit sample packing (see pack12.h): pairs packed by pack12_pack, or pack12_enque as MCU does, are unpacked by pack12_unpack and
+// pack12_unpack_float into the same values as a byte-by-byte reference, for lengths around the 4 pair blocks of the SSSE3 path.
+// CMakeLists.txt builds it with -mssse3 if the compiler takes it, so that path is tested (the default flags only have the scalar one)
+
+int failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+void reference(uint16_t* dest, const char* src, uint32_t pairs) {
+	for (uint32_t i=0; i<pairs; ++i) {
+		const unsigned char* p = (const unsigned char*)src + 3 * i;
+		dest[2 * i] = p[0] | ((p[1] & 0x0F) << 8);
+		dest[2 * i + 1] = (p[1] >> 4) | (p[2] << 4);
+	}
+}
+
+int main() {
+#if defined(__SSSE3__)
+	printf("unpack with SSSE3\n");
+#else
+	printf("unpack with the scalar loop only\n");
+#endif
+	srand(1);
+	uint32_t lengths[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 13, 84, 341, 1000, 100001 };
+	for (uint32_t pairs : lengths) {
+		std::vector<uint16_t> values(2 * pairs);
+		for (auto& v : values) v = rand() & 0xFFF;
+		if (pairs) values[0] = 0xFFF;  // all bits of both nibbles
+		std::vector<char> packed(3 * pairs);
+		for (uint32_t i=0; i<pairs; ++i) pack12_pack(&packed[3 * i], values[2 * i], values[2 * i + 1]);
+		std::vector<uint16_t> expected(2 * pairs);
+		reference(expected.data(), packed.data(), pairs);
+		CHECK(expected == values);
+
+		std::vector<uint16_t> unpacked(2 * pairs + 8, 0xABCD);  // guards behind
+		pack12_unpack(unpacked.data(), packed.data(), pairs);
+		int wrong = 0;
+		for (uint32_t i=0; i<2 * pairs; ++i) if (unpacked[i] != values[i]) ++wrong;
+		for (uint32_t i=2 * pairs; i<unpacked.size(); ++i) if (unpacked[i] != 0xABCD) ++wrong;
+		std::vector<float> floats(2 * pairs + 8, -1);
+		pack12_unpack_float(floats.data(), packed.data(), pairs, 0.5f);
+		for (uint32_t i=0; i<2 * pairs; ++i) if (floats[i] != values[i] * 0.5f) ++wrong;
+		for (uint32_t i=2 * pairs; i<floats.size(); ++i) if (floats[i] != -1) ++wrong;
+		if (wrong) printf("%u pairs: %d values wrong\n", pairs, wrong);
+		CHECK(wrong == 0);
+	}
+
+	// pack12_enque publishes the same bytes
+	char buf[64];
+	Fifo_t fifo;
+	fifo_init(&fifo, buf, sizeof(buf));
+	pack12_enque(&fifo, 0x123, 0xABC);
+	char pair[PACK12_PAIR_SIZE], expected[PACK12_PAIR_SIZE];
+	pack12_pack(expected, 0x123, 0xABC);
+	CHECK(fifo_move_to_buffer(pair, &fifo, sizeof(pair)) == PACK12_PAIR_SIZE && memcmp(pair, expected, sizeof(pair)) == 0);
+
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
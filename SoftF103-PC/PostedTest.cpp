@@ -0,0 +1,70 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+
+// posted writes (see SOFTIO_EXT_WRITE_POSTED) against a simulated SoftF103 in process: they hold no transaction slot and slave
+// replies nothing, they're applied in order with other requests, and a fence returns after all of them. without the feature they
+// fall back to acknowledged writes
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+int failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+void drain_slave() {  // slave handles all host has put, replies are kept in sim.replies
+	for (int rounds = 0; rounds < 1000 && (sim.packet_length || !fifo_empty(&sim.mem.siorx)); ++rounds) sim.step();
+}
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	CHECK(sio.features & SOFTIO_FEATURE_POSTED);
+
+	// more posted writes than the window holds, none of them waits for a slot or gets a reply
+	for (int i=0; i<1000; ++i) {
+		mem.tim2_period = i;
+		softio_delay_write_posted(sio, mem.tim2_period);
+		CHECK(sio.read == sio.write);
+	}
+	for (int i=0; i<600; ++i) mem.fifo1_buf[i] = (char)(i * 5 + 1);
+	__softio_delay_write_posted(&sio, mem.fifo1_buf, 600);  // extended, larger than a basic frame
+	softio_flush_fifo(sio, *sio.tx);
+	drain_slave();
+	CHECK(sim.replies.empty());
+	CHECK(sim.mem.tim2_period == 999 && memcmp(sim.mem.fifo1_buf, mem.fifo1_buf, 600) == 0);
+
+	// in order with acknowledged requests: a read after a posted write sees it
+	for (int i=0; i<100; ++i) {
+		mem.tim2_pulse = i;
+		softio_delay_write_posted(sio, mem.tim2_pulse);
+		mem.tim2_pulse = 0xFFFF;
+		softio_blocking(read, sio, mem.tim2_pulse);
+		CHECK(mem.tim2_pulse == i);
+	}
+
+	// a fence returns after the posted writes before it are done
+	mem.led = 1;
+	softio_delay_write_posted(sio, mem.led);
+	softio_delay_fence(sio);
+	CHECK(sio.read != sio.write);  // the fence holds a slot
+	softio_wait_delayed(sio);
+	CHECK(sim.mem.led == 1);
+
+	// fallback of a remote without posted writes: acknowledged, a fence is not sent
+	sio.features &= ~SOFTIO_FEATURE_POSTED;
+	mem.led = 0;
+	softio_delay_write_posted(sio, mem.led);
+	CHECK(sio.read != sio.write);
+	softio_wait_delayed(sio);
+	CHECK(sim.mem.led == 0);
+	softio_delay_fence(sio);
+	CHECK(sio.read == sio.write && fifo_empty(sio.tx));
+
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,110 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+
+// stored programs (see SOFTIO_EXT_RUN) against a simulated SoftF103 in process: writes, reads, a fifo read and a wait run in a single
+// exchange and the reply is scattered into local memory, a wait stops the program at its timeout, the slave caps a timeout longer
+// than SOFTIO_PROG_WAIT_MAX so that it returns well before host would resync, and without the feature host runs it by itself
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+SoftIO_Prog_t prog;
+int failed = 0;
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+void setup() {  // remote state the first program reads
+	sim.mem.led = 1;
+	sim.mem.tim2_period = 777;
+	sim.mem.tim1_PWM = 0;
+	fifo_clear(&sim.mem.fifo0);
+	fifo_copy_from_buffer(&sim.mem.fifo0, "hello", 5);
+	mem.pid = 0;
+	mem.tim2_period = 0;
+	fifo_clear(&mem.fifo0);
+}
+void check_first() {
+	char got[8] = {0};
+	CHECK(sio.executed == prog.count);
+	CHECK(sim.mem.tim1_prescaler == 71 && sim.mem.tim1_period == 999 && sim.mem.tim1_pulse == 500 && sim.mem.tim1_PWM == 1);
+	CHECK(mem.pid == MCU_PID && mem.tim2_period == 777);
+	CHECK(fifo_move_to_buffer(got, &mem.fifo0, sizeof(got)) == 5 && memcmp(got, "hello", 5) == 0);
+}
+double run_ms() {
+	auto start = std::chrono::steady_clock::now();
+	softio_delay_upload(sio, prog);
+	softio_delay_run(sio, prog);
+	softio_wait_delayed(sio);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() * 1e3;
+}
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	CHECK(sio.features & SOFTIO_FEATURE_PROGRAM);
+
+	// a setup sequence in one exchange
+	softio_prog_init(sio, prog, mem.program_buf);
+	mem.tim1_prescaler = 71;
+	mem.tim1_period = 999;
+	mem.tim1_pulse = 500;
+	softio_prog_write_between(sio, prog, mem.tim1_prescaler, mem.tim1_pulse);
+	mem.tim1_PWM = 1;
+	softio_prog_write(sio, prog, mem.tim1_PWM);
+	softio_prog_read(sio, prog, mem.pid);
+	softio_prog_read_fifo_part(sio, prog, mem.fifo0, 10);
+	softio_prog_wait(sio, prog, mem.led, 1, 1, 5);
+	softio_prog_read(sio, prog, mem.tim2_period);
+	setup();
+	uint32_t handled = sim.sio.handled;
+	run_ms();
+	CHECK(sim.sio.handled == handled + 2);  // upload and run
+	check_first();
+
+	// run again without upload
+	setup();
+	softio_delay_run(sio, prog);
+	softio_wait_delayed(sio);
+	check_first();
+
+	// a wait which never holds stops the program at its timeout
+	softio_prog_init(sio, prog, mem.program_buf);
+	softio_prog_wait(sio, prog, mem.led, 1, 1, 5);
+	mem.tim2_pulse = 55;
+	softio_prog_write(sio, prog, mem.tim2_pulse);
+	sim.mem.led = 0;
+	sim.mem.tim2_pulse = 0;
+	double ms = run_ms();
+	CHECK(sio.executed == 0 && sim.mem.tim2_pulse == 0);
+	CHECK(ms >= 4 && ms < SOFTIO_RESYNC_TIMEOUT);
+
+	// a timeout beyond SOFTIO_PROG_WAIT_MAX (from a host built with a larger one) is capped by slave
+	char* timeout = mem.program_buf + 4 + 8;
+	timeout[0] = (char)0xE8;  // 1000 ticks
+	timeout[1] = 0x03;
+	ms = run_ms();
+	CHECK(sio.executed == 0 && sim.mem.tim2_pulse == 0);
+	CHECK(ms < SOFTIO_RESYNC_TIMEOUT);
+	if (ms >= SOFTIO_RESYNC_TIMEOUT) printf("a wait of 1000 ticks took %.1f ms\n", ms);
+
+	// remote without programs, host sends the requests and polls the wait
+	sio.features &= ~SOFTIO_FEATURE_PROGRAM;
+	softio_prog_init(sio, prog, mem.program_buf);
+	softio_prog_write_between(sio, prog, mem.tim1_prescaler, mem.tim1_pulse);
+	softio_prog_write(sio, prog, mem.tim1_PWM);
+	softio_prog_read(sio, prog, mem.pid);
+	softio_prog_read_fifo_part(sio, prog, mem.fifo0, 10);
+	softio_prog_wait(sio, prog, mem.led, 1, 1, 5);
+	softio_prog_read(sio, prog, mem.tim2_period);
+	setup();
+	memset(&sim.mem.tim1_prescaler, 0, 6);
+	run_ms();
+	check_first();
+
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
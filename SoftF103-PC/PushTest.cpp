@@ -0,0 +1,73 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+#include <thread>
+
+// subscriptions (see SOFTIO_EXT_SUBSCRIBE) against a simulated SoftF103 in process: a periodic one brings remote changes into local
+// memory and calls its callback, an on-change one is pushed once per change and never while data stays the same, and nothing is
+// pushed after unsubscribing
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+int failed = 0;
+int pushes[2];
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+bool wait_push(int id, int count) {  // host handles frames until subscription `id` has been pushed `count` times
+	for (int frames = 0; frames < 1000 && pushes[id] < count; ++frames) softio_wait_frame(sio);
+	return pushes[id] >= count;
+}
+void idle(int ms) {  // slave runs alone, what it sends is left in sim.replies
+	auto end = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+	while (std::chrono::steady_clock::now() < end) {
+		sim.step();
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}
+}
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	CHECK(sio.features & SOFTIO_FEATURE_PUSH);
+	for (int id=0; id<2; ++id) sio.subs[id].callback = [id](void*, uint32_t pushed) { if (pushed == (uint32_t)id) ++pushes[id]; };
+
+	// periodic, remote changes come without a request
+	softio_delay_subscribe_between(sio, 0, mem.tim2_prescaler, mem.tim2_period, 1, 0);
+	softio_wait_delayed(sio);
+	CHECK(wait_push(0, 1));
+	sim.mem.tim2_prescaler = 71;
+	sim.mem.tim2_period = 1000;
+	int before = pushes[0];
+	for (int frames = 0; frames < 1000 && mem.tim2_period != 1000; ++frames) softio_wait_frame(sio);
+	CHECK(mem.tim2_prescaler == 71 && mem.tim2_period == 1000 && pushes[0] > before);
+
+	// unsubscribed, nothing more is pushed
+	softio_delay_unsubscribe(sio, 0);
+	softio_wait_delayed(sio);
+	CHECK(sim.sio.subs[0].length == 0);
+	sim.replies.clear();  // pushes sent before the unsubscribe was handled
+	idle(10);
+	CHECK(sim.replies.empty());
+
+	// on change, once per change
+	softio_delay_subscribe(sio, 1, mem.adc_overflow, 1, SOFTIO_SUB_ON_CHANGE);
+	softio_wait_delayed(sio);
+	CHECK(wait_push(1, 1));  // the first check always pushes
+	for (uint32_t i=1; i<=5; ++i) {
+		sim.mem.adc_overflow = i;
+		CHECK(wait_push(1, 1 + i) && mem.adc_overflow == i);
+	}
+	idle(10);
+	CHECK(sim.replies.empty());  // unchanged
+	sim.mem.adc_overflow = 6;
+	CHECK(wait_push(1, 7) && mem.adc_overflow == 6);
+	CHECK(pushes[1] == 7);
+
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
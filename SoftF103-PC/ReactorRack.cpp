@@ -0,0 +1,98 @@
+#include "stdio.h"
+#define SOFTIO_USE_FUNCTION
+#include "softf103.h"
+
+// many boards driven by one thread (see softio-reactor.h): each one checks its version, then keeps reading ADC1 with a few reads in flight
+
+#ifdef __linux__
+#include "softio-reactor.h"
+#include <stdlib.h>
+#include <termios.h>
+#include <memory>
+
+#define READS_IN_FLIGHT 4
+
+struct Board_t {
+	const char* port;
+	SoftF103_Mem_t mem;
+	SoftIO_t sio;
+	SoftIO_Futures_t futures;
+	int fd;
+	SoftIO_Reactor_t::Device_t* dev;
+	int state;  // 0: handshake to send, 1: handshake sent, 2: reading, 3: failed, 4: stopped
+	int pending;
+	uint32_t reads;
+	void poll() {
+		if (state == 0 && softio_can_issue(sio, 4)) {
+			futures.read_between(mem.version, mem.softio_features).then([this](bool done) {
+				state = done && mem.version == MCU_VERSION ? 2 : 3;
+				if (state == 2) sio.features = mem.softio_features & SOFTIO_FEATURES;  // only use extensions supported by both
+			});
+			state = 1;
+		}
+		while (state == 2 && pending < READS_IN_FLIGHT && softio_can_issue(sio, 4)) {
+			futures.read(mem.adc1).then([this](bool done) {
+				if (done) ++reads;
+				--pending;
+			});
+			++pending;
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		printf("usage: <seconds> <portname>...\n");
+		return -1;
+	}
+
+	double seconds = atof(argv[1]);
+	SoftIO_Reactor_t reactor;
+	std::vector<std::unique_ptr<Board_t>> boards;
+	for (int i = 2; i < argc; ++i) {
+		Board_t* b = new Board_t();
+		boards.emplace_back(b);
+		b->port = argv[i];
+		b->fd = ::open(b->port, O_RDWR | O_NOCTTY);
+		if (b->fd < 0) {
+			printf("cannot open \"%s\"\n", b->port);
+			return -1;
+		}
+		struct termios raw;
+		tcgetattr(b->fd, &raw);
+		cfmakeraw(&raw);
+		tcsetattr(b->fd, TCSANOW, &raw);
+		SOFTIO_QUICK_INIT(b->sio, b->mem, Mem_FifoInit);
+		b->futures.attach(b->sio);
+		b->state = 0;
+		b->pending = 0;
+		b->reads = 0;
+		b->dev = reactor.add(b->fd, b->futures, [b]() { b->poll(); });
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	auto elapsed = [&]() { return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count(); };
+	reactor.run_until([&]() { return elapsed() >= seconds; });
+	for (auto& b : boards) b->state = b->state == 2 ? 4 : b->state;  // stop issuing, let the ones in flight complete
+	reactor.run_until([&]() {
+		for (auto& b : boards) if (b->pending && b->state != 3) return false;
+		return true;
+	});
+
+	uint32_t total = 0;
+	for (auto& b : boards) {
+		printf("%s: %s, %.0f reads/s, %u errors\n", b->port, b->dev->failed ? "port gone" : b->state == 3 ? "failed" : "ok", b->reads / seconds, b->sio.errors);
+		total += b->reads;
+	}
+	printf("%zu boards: %.0f reads/s in total\n", boards.size(), total / seconds);
+	for (auto& b : boards) ::close(b->fd);
+
+	return 0;
+}
+
+#else
+int main() {
+	printf("reactor is only supported on Linux\n");
+	return 0;
+}
+#endif
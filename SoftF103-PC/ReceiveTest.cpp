@@ -0,0 +1,107 @@
+#include "stdio.h"
+#include "softf103.h"
+#include <string>
+
+// zero-copy input of slave (see softio_receive), fed like usb_fifo_receive of MCU does. a stream of extended frames larger than a
+// packet (posted write, credit, read and multi read) is cut into two packets at every position, so that each frame is handled from
+// the packet, staged in rx, or straddles both. the slave must take it all without error, and a host must get right replies.
+// replies are not compared byte by byte, since credit reports depend on when rx gets empty
+
+SoftF103_Mem_t host_mem;
+SoftIO_t host;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+
+// requests of host, returns the stream
+std::string host_requests() {
+	SOFTIO_QUICK_INIT(host, host_mem, Mem_FifoInit);
+	host.features = SOFTIO_FEATURES;
+	for (int i=0; i<300; ++i) host_mem.fifo0_buf[i] = (char)(i * 3 + 1);
+	memset(host_mem.fifo1_buf, 0, sizeof(host_mem.fifo1_buf));
+	host_mem.version = 0;
+	host_mem.mem_size = 0;
+	__softio_delay_write_posted(&host, host_mem.fifo0_buf, 300);
+	softio_delay_credit(host);
+	__softio_delay_read(&host, host_mem.fifo1_buf, 300);
+	SoftIO_Region_t regions[2] = { SOFTIO_REGION(host_mem.version), SOFTIO_REGION(host_mem.mem_size) };
+	softio_delay_read_multi(host, regions, 2);
+	std::string stream(fifo_count(&host_mem.siotx), 0);
+	fifo_move_to_buffer(&stream[0], &host_mem.siotx, stream.size());
+	return stream;
+}
+
+// a host handles replies of slave, returns the error or NULL
+const char* host_check(const std::string& replies) {
+	host_requests();
+	fifo_copy_from_buffer(&host_mem.siorx, replies.data(), replies.size());
+	while (!fifo_empty(&host_mem.siorx) && __softio_try_handle_one(&host) == 0);
+	if (host.errors) return host.error;
+	if (host.read != host.write) return "replies missing";
+	if (!fifo_empty(&host_mem.siorx)) return "replies left";
+	if (host.credit_capacity != fifo_capacity(&mem.siorx)) return "credit is not rx capacity";
+	if (memcmp(host_mem.fifo1_buf, mem.fifo1_buf, 300)) return "read wrong";
+	if (host_mem.version != MCU_VERSION || host_mem.mem_size != sizeof(mem)) return "multi read wrong";
+	if (memcmp(mem.fifo0_buf, host_mem.fifo0_buf, 300)) return "written wrong";
+	return NULL;
+}
+
+void slave_init() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	mem.version = MCU_VERSION;
+	mem.mem_size = sizeof(mem);
+	memset(mem.fifo0_buf, 0, sizeof(mem.fifo0_buf));
+	for (int i=0; i<300; ++i) mem.fifo1_buf[i] = (char)(i * 7);
+}
+
+// like the main loop of MCU: hand in the packet until it's all taken, handle frames and send replies
+void feed(const char* packet, uint32_t length, std::string& replies) {
+	uint32_t taken = 0;
+	for (int rounds = 0; rounds < 100; ++rounds) {
+		taken += softio_receive(sio, packet + taken, length - taken);
+		softio_try_handle_all(sio);
+		char buf[1024];
+		uint32_t n = fifo_move_to_buffer(buf, &mem.siotx, sizeof(buf));
+		replies.append(buf, n);
+		if (taken == length) return;
+	}
+	printf("packet is never taken\n");
+}
+
+int main() {
+	std::string stream = host_requests();
+	uint32_t length = stream.size();
+
+	// reference: the whole stream in rx
+	slave_init();
+	std::string replies;
+	fifo_copy_from_buffer(&mem.siorx, stream.data(), length);
+	feed(NULL, 0, replies);
+	const char* error = host_check(replies);
+	if (sio.errors || error) {
+		printf("reference failed: %s\n", sio.errors ? sio.error : error);
+		return 1;
+	}
+
+	char packet[1024];  // on stack like the USB buffer, so the view of it is in reach (see fifo_in_reach)
+	Fifo_t probe;
+	if (!fifo_in_reach(&probe, packet)) {
+		printf("packet not in reach, zero-copy path not tested\n");
+		return 1;
+	}
+	int failed = 0;
+	for (uint32_t cut=1; cut<length; ++cut) {
+		slave_init();
+		replies.clear();
+		memcpy(packet, stream.data(), cut);
+		feed(packet, cut, replies);
+		memcpy(packet, stream.data() + cut, length - cut);
+		feed(packet, length - cut, replies);
+		error = sio.errors ? sio.error : host_check(replies);
+		if (error) {
+			printf("cut at %u: %s\n", cut, error);
+			++failed;
+		}
+	}
+	printf("%u byte stream cut at %u positions: %d failed\n", length, length - 1, failed);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+#include "stdio.h"
+#define SOFTIO_USE_FUNCTION
+#include "softf103.h"
+#include "serial/serial.h"
+#include <chrono>
+#include <stdlib.h>
+
+// pipelined writes and reads over a link which may flip bits, e.g. `Simulator -c 5000 ./Resync @ 20000` (see Simulator.cpp).
+// corrupt frames are discarded and both sides resync (see __softio_error), so every transaction completes. a flipped bit of a head
+// isn't detected (see SOFTIO_CHECK), so read back values may differ during the run, but a final write must land.
+// then pipelined multi reads of a byte each in program_buf, more regions than the region ring holds, so that resync often completes while
+// regions are staged (see __softio_resynced). multi reads are not sent again, so they may be lost, but each one replied must scatter right.
+// a region is a byte, so two flips which cancel in the 8bit checksum misplace at most two bytes of a reply, more means the ring is out of step.
+// fails if a transaction other than a multi read is lost, a final value is wrong, a reply scatters wrong or the ring is left out of step
+
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+SoftIO_Region_t regions[100];  // a byte each, the ring holds SOFTIO_REGION_LENGTH - 1
+char pattern[100];
+
+bool write_landed() {  // retried if a flipped head sends it elsewhere
+	for (int retry = 0; retry < 10; ++retry) {
+		softio_blocking(write_between, sio, mem.tim1_pulse, mem.program_buf[99]);
+		uint16_t pulse = mem.tim1_pulse;
+		memset(mem.program_buf, 0, 100);
+		softio_blocking(read_between, sio, mem.tim1_pulse, mem.program_buf[99]);
+		if (mem.tim1_pulse == pulse && memcmp(mem.program_buf, pattern, 100) == 0) return true;
+		memcpy(mem.program_buf, pattern, 100);
+		mem.tim1_pulse = pulse;
+	}
+	return false;
+}
+
+int main(int argc, char** argv) {
+	if (argc != 2 && argc != 3) {
+		printf("usage: <portname> [count]\n");
+		return -1;
+	}
+	int count = argc > 2 ? atoi(argv[2]) : 20000;
+	serial::Serial com(argv[1], 115200, serial::Timeout::simpleTimeout(1000));
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sio.gets = [&](char *buffer, size_t size)->size_t {
+		uint32_t timeout = sio.resync ? SOFTIO_RESYNC_TIMEOUT : 1000;  // like SoftF103Host_t
+		if (com.getTimeout().read_timeout_constant != timeout) {
+			serial::Timeout t = serial::Timeout::simpleTimeout(timeout);
+			com.setTimeout(t);
+		}
+		return com.read((uint8_t*)buffer, size);
+	};
+	sio.puts = [&](char *buffer, size_t size)->size_t { return com.write((uint8_t*)buffer, size); };
+	sio.features = SOFTIO_FEATURES;  // the simulated board has them all, so the first exchange recovers from corruption too
+
+	int mismatch = 0;
+	double worst = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i=0; i<count; ++i) {
+		mem.tim1_pulse = i;
+		softio_delay_write(sio, mem.tim1_pulse);
+		softio_delay_read(sio, mem.version);
+		if (i % 16 == 15) {
+			auto begin = std::chrono::steady_clock::now();
+			softio_blocking(read, sio, mem.tim1_pulse);
+			worst = std::max(worst, std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+			if (mem.tim1_pulse != (uint16_t)i) ++mismatch;
+		}
+	}
+	softio_wait_all(sio);
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	mem.tim1_pulse = 0xA5A5;  // the last write, with the pattern for multi reads
+	for (int i=0; i<100; ++i) {
+		pattern[i] = i + 1;
+		mem.program_buf[i] = pattern[i];
+		regions[i] = SOFTIO_REGION(mem.program_buf[i]);
+	}
+	bool landed = write_landed();
+	uint32_t lost = sio.lost;
+	int misplaced = 0, wrong = 0;  // bytes, and replies with more than two
+	memset(mem.program_buf, 0, 100);
+	sio.callback = [&](void*, SoftIO_Head_t* head) {
+		if (head->type != SOFTIO_HEAD_TYPE_EXTEND || head->length != SOFTIO_EXT_READ_MULTI) return;
+		int bytes = 0;
+		for (int i=0; i<100; ++i) if (mem.program_buf[i] && mem.program_buf[i] != pattern[i]) ++bytes;
+		misplaced += bytes;
+		if (bytes > 2) ++wrong;
+		memset(mem.program_buf, 0, 100);
+	};
+	for (int i=0; i<count / 16; ++i) softio_delay_read_multi(sio, regions, 100);
+	softio_wait_all(sio);
+	sio.callback = nullptr;
+	bool ring = softio_region_count(sio) == 0;  // every region is scattered by its reply or freed by resync
+	printf("%.0f ops/s, %u errors, %u lost, %d/%d read back wrong, worst wait %.1f ms, last error: %s\n", 2 * count / seconds, sio.errors,
+		lost, mismatch, count / 16, worst * 1e3, sio.error ? sio.error : "-");
+	printf("%d multi reads of 100 regions: %u lost, %d bytes misplaced, %d replies scattered wrong\n", count / 16, sio.lost - lost, misplaced, wrong);
+	if (lost || !landed || wrong || !ring) {
+		printf("FAILED: %s\n", lost ? "transactions lost" : !landed ? "final write is wrong" : wrong ? "multi reads scattered wrong" :
+			"region ring is out of step");
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,119 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+
+// run a program against simulated boards (see softf103-sim.h), each on a pty: every "@" in its arguments is replaced by the port of a
+// new board, e.g. `Simulator ./CoroStreaming @ 20000 5000` or `Simulator ./ReactorRack 2 @ @ @ @`. returns what the program returns.
+// `Simulator -c 5000 ./Resync @` flips a random bit in one of 5000 bytes on average in both directions (see SoftF103_Sim_t::corrupt)
+
+#ifdef __linux__
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <spawn.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Board_t {
+	SoftF103_Sim_t sim;
+	int master;
+	int slave;  // kept open, so master doesn't hang up when program closes the port
+	std::string port;
+	std::string out;  // transmitted, not written to pty yet
+	bool moved;  // rx was consumed or tx drained by the last serve, so requests left in rx (e.g., waiting for tx room) may go on
+	Board_t() {
+		moved = false;
+		master = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+		assert(master >= 0 && grantpt(master) == 0 && unlockpt(master) == 0 && "cannot open pty");
+		port = ptsname(master);
+		slave = ::open(port.c_str(), O_RDWR | O_NOCTTY);
+		struct termios raw;
+		tcgetattr(slave, &raw);
+		cfmakeraw(&raw);
+		tcsetattr(slave, TCSANOW, &raw);
+	}
+	~Board_t() {
+		::close(slave);
+		::close(master);
+	}
+	bool busy() {  // main loop of MCU never sleeps, but here it only spins when there is something to do
+		return sim.packet_length || !out.empty() || (moved && !fifo_empty(&sim.mem.siorx)) || !fifo_empty(&sim.mem.siotx) || sim.sio.subscribed || sim.sio.deferred ||
+			(sim.mem.tim1_IT && (sim.mem.gpio_count || sim.mem.adc_count));
+	}
+	void serve(short revents) {
+		if (!sim.packet_length && (revents & POLLIN)) {
+			char packet[SOFTF103_SIM_PACKET];
+			ssize_t n = read(master, packet, sizeof(packet));
+			if (n > 0) sim.receive(packet, n);
+		}
+		uint32_t read = sim.mem.siorx.read;
+		sim.loop();
+		moved = sim.mem.siorx.read != read;  // a partial frame doesn't, it waits for host
+		if (out.empty()) {
+			char buf[1024];
+			out.assign(buf, sim.transmit(buf, sizeof(buf)));
+			moved = moved || !out.empty();
+		}
+		if (!out.empty()) {
+			ssize_t n = write(master, out.data(), out.size());
+			if (n > 0) out.erase(0, n);
+		}
+	}
+};
+
+int main(int argc, char** argv) {
+	uint32_t corrupt = 0;
+	if (argc > 2 && std::string(argv[1]) == "-c") {
+		corrupt = atoi(argv[2]);
+		argc -= 2;
+		argv += 2;
+	}
+	if (argc < 2) {
+		printf("usage: [-c <bytes per bit flip>] <program> [arguments, \"@\" for the port of a simulated board]...\n");
+		return -1;
+	}
+	std::vector<std::unique_ptr<Board_t>> boards;
+	std::vector<std::string> args(argv + 1, argv + argc);
+	for (auto& arg : args) if (arg == "@") {
+		boards.emplace_back(new Board_t());
+		boards.back()->sim.corrupt = corrupt;
+		arg = boards.back()->port;
+	}
+	std::vector<char*> child_argv;
+	for (auto& arg : args) child_argv.push_back(&arg[0]);
+	child_argv.push_back(NULL);
+	pid_t pid;
+	if (posix_spawnp(&pid, child_argv[0], NULL, NULL, child_argv.data(), environ) != 0) {
+		printf("cannot run %s\n", child_argv[0]);
+		return -1;
+	}
+
+	int status;
+	std::vector<struct pollfd> fds(boards.size());
+	while (waitpid(pid, &status, WNOHANG) == 0) {
+		bool busy = false;
+		for (size_t i=0; i<boards.size(); ++i) {
+			fds[i] = { boards[i]->master, POLLIN, 0 };
+			busy = busy || boards[i]->busy();
+		}
+		poll(fds.data(), fds.size(), busy ? 0 : 1);
+		for (size_t i=0; i<boards.size(); ++i) boards[i]->serve(fds[i].revents);
+	}
+	for (auto& b : boards) if (b->sim.sio.errors || b->sim.flips) fprintf(stderr, "%s: %u bits flipped, %u errors, the last is %s\n",
+		b->port.c_str(), b->sim.flips, b->sim.sio.errors, b->sim.sio.error ? b->sim.sio.error : "-");
+
+	if (WIFSIGNALED(status)) return 128 + WTERMSIG(status);
+	return WEXITSTATUS(status);
+}
+
+#else
+int main() {
+	printf("simulator is only supported on Linux\n");
+	return 0;
+}
+#endif
@@ -0,0 +1,71 @@
+#include "stdio.h"
+#include "fifo.h"
+#include <thread>
+#include <chrono>
+
+// throughput of fifo_spsc_xxx against the plain functions on one thread, which is the cost of ordering, and between two threads
+
+#define TOTAL (1u << 28)
+
+// buffers next to fifos, within reach on 64-bit (see fifo_in_reach)
+char buf[1024];
+Fifo_t fifo;
+volatile uint32_t sink;
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <bool SPSC> void single(const char* name) {
+	fifo_init(&fifo, buf, 1021);
+	uint32_t sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t n = 0; n < TOTAL / 16; n += 256) {
+		for (int i=0; i<256; ++i) { if (SPSC) fifo_spsc_enque(&fifo, (char)i); else fifo_enque(&fifo, (char)i); }
+		for (int i=0; i<256; ++i) sum += SPSC ? fifo_spsc_deque(&fifo) : fifo_deque(&fifo);
+	}
+	double bytewise = seconds_since(start);
+	char chunk[256];
+	start = std::chrono::steady_clock::now();
+	for (uint32_t n = 0; n < TOTAL; n += 256) {
+		if (SPSC) {
+			fifo_spsc_copy_from_buffer(&fifo, chunk, 256);
+			fifo_spsc_move_to_buffer(chunk, &fifo, 256);
+		} else {
+			fifo_copy_from_buffer(&fifo, chunk, 256);
+			fifo_move_to_buffer(chunk, &fifo, 256);
+		}
+		sum += chunk[n & 255];
+	}
+	double bulk = seconds_since(start);
+	sink = sum;
+	printf("%s, one thread: bytewise %.1f MB/s, bulk of 256 bytes %.1f MB/s\n", name, TOTAL / 16 / bytewise / 1e6, TOTAL / bulk / 1e6);
+}
+
+void threads() {
+	fifo_init(&fifo, buf, 1021);
+	auto start = std::chrono::steady_clock::now();
+	std::thread producer([]() {
+		char chunk[256] = { 0 };
+		for (uint32_t n = 0; n < TOTAL; ) {
+			uint32_t put = fifo_spsc_copy_from_buffer(&fifo, chunk, 256);
+			if (!put) std::this_thread::yield();
+			n += put;
+		}
+	});
+	char chunk[256];
+	for (uint32_t n = 0; n < TOTAL; ) {
+		uint32_t got = fifo_spsc_move_to_buffer(chunk, &fifo, 256);
+		if (!got) std::this_thread::yield();
+		n += got;
+	}
+	producer.join();
+	printf("spsc, two threads: bulk of 256 bytes %.1f MB/s on %u cpus\n", TOTAL / seconds_since(start) / 1e6, std::thread::hardware_concurrency());
+}
+
+int main() {
+	single<false>("plain");
+	single<true>("spsc");
+	threads();
+	return 0;
+}
@@ -0,0 +1,75 @@
+#include "stdio.h"
+#include "fifo.h"
+#include <thread>
+#include <stdlib.h>
+
+// fifo_spsc_xxx shared by two threads: a producer puts a counter sequence in chunks of random size, bytewise or in bulk, and a consumer
+// checks it. lengths of 1021 (modulo, wraps at every place) and 1024 (pow2) with fifo1k_xxx, see FIFO_POW2_FUNCTIONS
+
+FIFO_POW2_FUNCTIONS(fifo1k, 1024)
+
+#define TOTAL (1u << 24)
+
+// buffers next to fifos, within reach on 64-bit (see fifo_in_reach)
+char buf[1024];
+Fifo_t fifo;
+
+enum Mode_t { BYTEWISE, BULK, FIFO1K };
+
+uint32_t produce(Mode_t mode, uint32_t n, uint32_t want) {
+	if (mode == BULK) {
+		char chunk[300];
+		for (uint32_t i=0; i<want; ++i) chunk[i] = (char)(n + i);
+		return fifo_spsc_copy_from_buffer(&fifo, chunk, want);
+	}
+	uint32_t i = 0;
+	if (mode == BYTEWISE) for (; i<want && !fifo_spsc_full(&fifo); ++i) fifo_spsc_enque(&fifo, (char)(n + i));
+	else for (; i<want && !fifo1k_full(&fifo); ++i) fifo1k_enque(&fifo, (char)(n + i));
+	return i;
+}
+
+uint32_t consume(Mode_t mode, uint32_t n, uint32_t want, uint32_t* bad) {
+	if (mode == BULK) {
+		char chunk[300];
+		uint32_t got = fifo_spsc_move_to_buffer(chunk, &fifo, want);
+		for (uint32_t i=0; i<got; ++i) if (chunk[i] != (char)(n + i)) ++*bad;
+		return got;
+	}
+	uint32_t i = 0;
+	if (mode == BYTEWISE) for (; i<want && !fifo_spsc_empty(&fifo); ++i) *bad += fifo_spsc_deque(&fifo) != (char)(n + i);
+	else for (; i<want && !fifo1k_empty(&fifo); ++i) *bad += fifo1k_deque(&fifo) != (char)(n + i);
+	return i;
+}
+
+uint32_t stress(Mode_t mode, bool pow2) {
+	if (pow2) fifo_init_pow2(&fifo, buf, 1024);
+	else fifo_init(&fifo, buf, 1021);
+	std::thread producer([mode]() {
+		unsigned seed = 1;
+		for (uint32_t n = 0; n < TOTAL; ) {
+			uint32_t put = produce(mode, n, rand_r(&seed) % 300 + 1);
+			if (!put) std::this_thread::yield();
+			n += put;
+		}
+	});
+	unsigned seed = 2;
+	uint32_t bad = 0;
+	for (uint32_t n = 0; n < TOTAL; ) {
+		uint32_t got = consume(mode, n, rand_r(&seed) % 300 + 1, &bad);
+		if (!got) std::this_thread::yield();
+		n += got;
+	}
+	producer.join();
+	return bad;
+}
+
+int main() {
+	const char* names[3] = { "bytewise", "bulk", "fifo1k" };
+	int failed = 0;
+	for (int pow2 = 0; pow2 < 2; ++pow2) for (int mode = BYTEWISE; mode <= BULK + pow2; ++mode) {
+		uint32_t bad = stress((Mode_t)mode, pow2);
+		printf("%s, %s: %u bytes, %u bad\n", pow2 ? "pow2" : "modulo", names[mode], TOTAL, bad);
+		if (bad || !fifo_spsc_empty(&fifo)) ++failed;
+	}
+	return failed ? 1 : 0;
+}
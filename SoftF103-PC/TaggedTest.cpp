@@ -0,0 +1,66 @@
+#include "stdio.h"
+#define SOFTF103SIM_IMPLEMENTATION
+#include "softf103-sim.h"
+
+// tagged reads (see SOFTIO_EXT_READ_TAGGED) against a simulated SoftF103 in process: a read which slave defers (see `ready`) doesn't
+// hold the replies of requests after it, tagged reads complete out of order, and the data is taken when it's ready. without the
+// feature it's an ordinary read
+
+SoftF103_Sim_t sim;
+SoftF103_Mem_t mem;
+SoftIO_t sio;
+int failed = 0;
+bool converted;  // the slow "conversion" of adc1 is done
+
+#define CHECK(cond) do { if (!(cond)) { printf("line %d: %s failed\n", __LINE__, #cond); ++failed; } } while (0)
+
+void wait_window() {  // softio_wait_all (and softio_blocking) would wait for pending tags too
+	while (sio.read != sio.write) softio_wait_one(sio);
+}
+
+int main() {
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	sim.attach(sio);
+	uint32_t adc1 = (char*)&sim.mem.adc1 - (char*)&sim.mem;
+	sim.sio.ready = [adc1](void*, SoftIO_Head_t* head)->int { return head->addr != adc1 || converted; };
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.softio_features & SOFTIO_FEATURES;
+	CHECK(sio.features & SOFTIO_FEATURE_TAGGED);
+
+	// requests after a deferred read are replied meanwhile
+	uint32_t slow = softio_delay_read_tagged(sio, mem.adc1);
+	CHECK(slow != SOFTIO_TAG_NONE);
+	for (int i=0; i<50; ++i) {
+		mem.tim2_period = i;
+		softio_delay_write(sio, mem.tim2_period);
+		mem.tim2_period = 0xFFFF;
+		softio_delay_read(sio, mem.tim2_period);
+		wait_window();
+		CHECK(mem.tim2_period == i);
+	}
+	CHECK(sio.tags & (1u << slow));
+
+	// a later tagged read which is ready completes first
+	uint32_t fast = softio_delay_read_tagged(sio, mem.pid);
+	CHECK(fast != slow);
+	mem.pid = 0;
+	softio_wait_tag(sio, fast);
+	CHECK(mem.pid == MCU_PID && (sio.tags & (1u << slow)));
+
+	// the deferred one, once ready, with a value taken after that
+	converted = true;
+	softio_wait_tag(sio, slow);
+	CHECK(!(sio.tags & (1u << slow)) && mem.adc1 == sim.mem.adc1);
+
+	// remote without tagged reads
+	sio.features &= ~SOFTIO_FEATURE_TAGGED;
+	mem.pid = 0;
+	uint32_t tag = softio_delay_read_tagged(sio, mem.pid);
+	CHECK(tag == SOFTIO_TAG_NONE && sio.read != sio.write);
+	softio_wait_tag(sio, tag);
+	CHECK(mem.pid == MCU_PID);
+
+	CHECK(sio.errors == 0 && sim.sio.errors == 0);
+	printf("%s\n", failed ? "FAILED" : "passed");
+	return failed ? 1 : 0;
+}
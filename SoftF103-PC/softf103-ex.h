@@ -1,5 +1,8 @@
 #define SOFTIO_USE_FUNCTION
 #include "softf103.h"
+#include "softio-future.h"
+#include "softio-thread.h"
+#include "softio-mirror.h"
 #include "assert.h"
 #include "serial/serial.h"
 #include <chrono>
@@ -15,9 +18,18 @@ struct SoftF103Host_t {
 	serial::Serial *com;
 	string port;
 	bool verbose;
+	bool threaded;  // set before open, to move bytes of port in background threads (see softio-thread.h)
+	SoftIO_Threaded_t *io;  // NULL if not threaded
+	bool mirrored;  // set before open, to receive into a mirror mapped buffer of 64kB (see softio-mirror.h), ignored if not supported
+	SoftIO_Mirror_t mirror;
 	uint16_t pid;  // written after device is opened
 	SoftF103_Mem_t mem;
 	SoftIO_t sio;
+	vector<SoftIO_Trans_t> window;  // deeper transaction window, used when credit flow control is enabled
+	vector<char> shadow;  // what device has for timer configurations, see softio_track_between
+	vector<char> shadow_fields;  // timer fields with write hooks on MCU, see softio_track_hooked
+	SoftIO_Prog_t prog;  // setup sequence of streaming, built in mem.program_buf
+	SoftIO_Futures_t futures;  // e.g., `futures.read(mem.gpio_in).then(...)`, completed by any wait of sio
 	mutex lock;
 	SoftF103Host_t();
 	int open(const char* port);
@@ -31,12 +43,14 @@ struct SoftF103Host_t {
 	int dump(int elements = 0);
 // GPIO control
 	void GPIO_write(uint8_t output);
+	uint8_t GPIO_update(uint8_t mask, uint8_t output);  // only change bits in mask, return the previous output
 	uint8_t GPIO_read();
 	void GPIO_streaming(float frequency, vector<uint8_t> samples);
 	void LED_set(bool opened);
 // Timer control: timer = 1 or 2
 	pair<float, float> Timer_Start_PWM(int timer, float frequency, float duty);
 	float Timer_Start_IT(int timer, float frequency);
+	float Timer_Set_IT(int timer, float frequency);  // only set local memory, return actual frequency
 // ADC control
 	float ADC_read(int adc);  // adc = 1 or 2
 	pair<float, float> ADC_read_both();  // still read adc1 then adc2, NOT simultaneous only much shorter interval
@@ -49,6 +63,9 @@ struct SoftF103Host_t {
 SoftF103Host_t::SoftF103Host_t() {
 	com = NULL;
 	verbose = false;
+	threaded = false;
+	io = NULL;
+	mirrored = false;
 }
 
 int SoftF103Host_t::open(const char* _port) {
@@ -61,7 +78,13 @@ int SoftF103Host_t::open(const char* _port) {
 	assert(com->isOpen() && "port is not opened");
 	// setup softio controller
 	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	if (mirrored && !mirror.map(&mem.siorx, 1 << 16) && verbose) printf("mirror mapped buffer not supported, use siorx_buf\n");
 	sio.gets = [&](char *buffer, size_t size)->size_t {
+		uint32_t timeout = sio.resync ? SOFTIO_RESYNC_TIMEOUT : 1000;  // a lost marker of resync is found sooner
+		if (com->getTimeout().read_timeout_constant != timeout) {
+			serial::Timeout t = serial::Timeout::simpleTimeout(timeout);
+			com->setTimeout(t);
+		}
 		size_t s = com->read((uint8_t*)buffer, size);
 		com->flush();
 		return s;
@@ -74,18 +97,51 @@ int SoftF103Host_t::open(const char* _port) {
 	sio.available = [&]()->size_t {
 		return com->available();
 	};
+	if (threaded) {  // softio takes the rings instead. no flush of port, which waits for the blocking read of reader thread
+		io = new SoftIO_Threaded_t();
+		io->start([&](char *buffer, size_t size)->size_t {
+			return com->read((uint8_t*)buffer, size);
+		}, [&](char *buffer, size_t size)->size_t {
+			return com->write((uint8_t*)buffer, size);
+		}, [&]()->size_t {
+			return com->available();
+		});
+		io->attach(sio);
+	}
 	sio.callback = [&](void* softio, SoftIO_Head_t* head)->void {
 		assert(softio);
 		assert(head);
 	};
-	// initialize device and verify it
-	softio_blocking(read, sio, mem.version);
+	futures.attach(sio);
+	// initialize device and verify it. the feature word is at offset 12, which legacy firmware also has (with other fields), so it's read
+	//   in the same basic frame and only trusted when version matches. zero means no extensions
+	softio_blocking(read_between, sio, mem.version, mem.softio_features);
+	sio.features = mem.version == MCU_VERSION ? mem.softio_features & SOFTIO_FEATURES : 0;  // only use extensions supported by both
 	assert(mem.version == MCU_VERSION && "version not match");
-	softio_blocking(read, sio, mem.mem_size);
 	assert(mem.mem_size == sizeof(mem) && "memory size not equal, this should NOT occur");
 	softio_blocking(read, sio, mem.pid);
 	pid = mem.pid;
-	if (verbose) printf("device \"%s\" opened, version = 0x%08X, pid = 0x%04X, shared memory size = %d bytes\n", port.c_str(), mem.version, mem.pid, mem.mem_size);
+	softio_blocking(credit, sio);  // remote rx never overflows after this, so the pipeline could be as deep as it holds
+	if (sio.credit_capacity) {
+		window.resize(256);
+		softio_set_window(sio, window.data(), window.size());
+	}
+	shadow.resize((char*)&mem.tim2_pulse + sizeof(mem.tim2_pulse) - (char*)&mem.tim1_PWM);
+	softio_track_between(sio, shadow.data(), mem.tim1_PWM, mem.tim2_pulse);
+	shadow_fields.resize(shadow.size());
+	softio_track_fields(sio, shadow_fields.data());  // MCU has a write hook on each of them, so they're written whole and never resent
+	softio_track_hooked(sio, mem.tim1_PWM);
+	softio_track_hooked(sio, mem.tim1_IT);
+	softio_track_hooked(sio, mem.tim1_prescaler);
+	softio_track_hooked(sio, mem.tim1_period);
+	softio_track_hooked(sio, mem.tim1_pulse);
+	softio_track_hooked(sio, mem.tim2_PWM);
+	softio_track_hooked(sio, mem.tim2_IT);
+	softio_track_hooked(sio, mem.tim2_prescaler);
+	softio_track_hooked(sio, mem.tim2_period);
+	softio_track_hooked(sio, mem.tim2_pulse);
+	softio_blocking(read_between, sio, mem.tim1_PWM, mem.tim2_pulse);  // shadow is filled as well
+	if (verbose) printf("device \"%s\" opened, version = 0x%08X, pid = 0x%04X, shared memory size = %d bytes, softio features = 0x%08X\n", port.c_str(), mem.version, mem.pid, mem.mem_size, sio.features);
 	lock.unlock();
 	return 0;
 }
@@ -94,9 +150,14 @@ int SoftF103Host_t::close() {
 	assert(com && "device not opened");
 	lock.lock();
 	softio_wait_all(sio);
+	if (io) {
+		delete io;  // stops threads
+		io = NULL;
+	}
 	com->close();
 	delete com;
 	com = NULL;
+	mirror.unmap();  // siorx is initialized again by open
 	lock.unlock();
 	return 0;
 }
@@ -104,18 +165,22 @@ int SoftF103Host_t::close() {
 int SoftF103Host_t::dump(int elements) {
 	assert(com && "device not opened");
 	lock.lock();
+	vector<SoftIO_Region_t> regions;  // fetch all of them in one transaction
+	if (elements & DUMP_BASIC) regions.push_back(SOFTIO_REGION_BETWEEN(mem.status, mem.siorx_overflow));
+	if (elements & DUMP_GPIO) regions.push_back(SOFTIO_REGION_BETWEEN(mem.gpio_out, mem.gpio_in));
+	if (elements & DUMP_TIMER) regions.push_back(SOFTIO_REGION_BETWEEN(mem.tim1_PWM, mem.tim2_pulse));
+	if (!regions.empty()) softio_blocking(read_multi, sio, regions.data(), regions.size());
 	if (elements & DUMP_BASIC) {
-		softio_blocking(read_between, sio, mem.status, mem.siorx_overflow);
 		printf("[basic information]\n");
 		printf("  1. status: 0x%02X [%s]\n", mem.status, STATUS_STR(mem.status));
 		printf("  2. verbose_level: 0x%02X\n", mem.verbose_level);
 		printf("  3. pid: 0x%04X\n", mem.pid);
 		printf("  4. version: 0x%08X\n", mem.version);
 		printf("  5. mem_size: %d\n", (int)mem.mem_size);
-		printf("  6. siorx_overflow: %d\n", (int)mem.siorx_overflow);
+		printf("  6. softio_features: 0x%08X\n", mem.softio_features);
+		printf("  7. siorx_overflow: %d\n", (int)mem.siorx_overflow);
 	}
 	if (elements & DUMP_GPIO) {
-		softio_blocking(read_between, sio, mem.gpio_out, mem.gpio_in);
 		printf("[GPIO information]\n");
 		printf("  1. out (PB7-PB0): ");
 		for (int i=7; i>=0; --i) printf("%d", 0x01&(mem.gpio_out>>i));
@@ -125,7 +190,6 @@ int SoftF103Host_t::dump(int elements) {
 		printf("\n");
 	}
 	if (elements & DUMP_TIMER) {
-		softio_blocking(read_between, sio, mem.tim1_PWM, mem.tim2_pulse);
 		printf("[Timer information]\n");
 		const float clock = 72e6;
 		printf("  1. tim1:\n");
@@ -150,6 +214,14 @@ void SoftF103Host_t::GPIO_write(uint8_t output) {
 	lock.unlock();
 }
 
+uint8_t SoftF103Host_t::GPIO_update(uint8_t mask, uint8_t output) {
+	lock.lock();
+	uint32_t old;
+	softio_blocking(write_masked, sio, mem.gpio_out, mask, output, &old);  // no read round trip before
+	lock.unlock();
+	return old;
+}
+
 uint8_t SoftF103Host_t::GPIO_read() {
 	lock.lock();
 	softio_blocking(read, sio, mem.gpio_in);
@@ -185,22 +257,31 @@ pair<float, float> SoftF103Host_t::Timer_Start_PWM(int timer, float frequency, f
 		mem.tim1_prescaler = prescaler;
 		mem.tim1_period = period;
 		mem.tim1_pulse = pulse;
-		softio_blocking(write_between, sio, mem.tim1_prescaler, mem.tim1_pulse);
+		softio_delay_sync_dirty_between(sio, mem.tim1_prescaler, mem.tim1_pulse);  // configuration first, pipelined with enabling
 		mem.tim1_PWM = 1;
-		softio_blocking(write, sio, mem.tim1_PWM);
 	} else {
 		mem.tim2_prescaler = prescaler;
 		mem.tim2_period = period;
 		mem.tim2_pulse = pulse;
-		softio_blocking(write_between, sio, mem.tim2_prescaler, mem.tim2_pulse);
+		softio_delay_sync_dirty_between(sio, mem.tim2_prescaler, mem.tim2_pulse);
 		mem.tim2_PWM = 1;
-		softio_blocking(write, sio, mem.tim2_PWM);
 	}
+	softio_blocking(sync_dirty, sio);
 	lock.unlock();
 	return make_pair(frequency_real, duty_real);
 }
 
 float SoftF103Host_t::Timer_Start_IT(int timer, float frequency) {
+	lock.lock();
+	float frequency_real = Timer_Set_IT(timer, frequency);
+	if (timer == 1) softio_delay_sync_dirty_between(sio, mem.tim1_prescaler, mem.tim1_period);  // configuration first, like Timer_Start_PWM
+	else softio_delay_sync_dirty_between(sio, mem.tim2_prescaler, mem.tim2_period);
+	softio_blocking(sync_dirty, sio);
+	lock.unlock();
+	return frequency_real;
+}
+
+float SoftF103Host_t::Timer_Set_IT(int timer, float frequency) {
 	assert((timer == 1 || timer == 2) && "invalid timer number");
 	const float clock = 72e6;
 	float period_target = clock / frequency - 0.5;
@@ -213,31 +294,29 @@ float SoftF103Host_t::Timer_Start_IT(int timer, float frequency) {
 	prescaler -= 1;
 	uint32_t period = period_target;
 	float frequency_real = clock / (prescaler + 1.f) / period;
-	lock.lock();
 	if (timer == 1) {
 		mem.tim1_prescaler = prescaler;
 		mem.tim1_period = period;
-		softio_blocking(write_between, sio, mem.tim1_prescaler, mem.tim1_period);
 		mem.tim1_IT = 1;
-		softio_blocking(write, sio, mem.tim1_IT);
 	} else {
 		mem.tim2_prescaler = prescaler;
 		mem.tim2_period = period;
-		softio_blocking(write_between, sio, mem.tim2_prescaler, mem.tim2_period);
 		mem.tim2_IT = 1;
-		softio_blocking(write, sio, mem.tim2_IT);
 	}
-	lock.unlock();
 	return frequency_real;
 }
 
 void SoftF103Host_t::GPIO_streaming(float frequency, vector<uint8_t> samples) {
 	mem.gpio_count = 0;
 	mem.gpio_underflow = 0;
-	softio_blocking(write_between, sio, mem.gpio_count, mem.gpio_underflow);  // clear previous count and underflow count
-	softio_blocking(reset_fifo, sio, mem.fifo0);  // reset fifo0
+	float actual = Timer_Set_IT(1, frequency);
+	softio_prog_init(sio, prog, mem.program_buf);  // the whole setup in a single exchange
+	softio_prog_write_between(sio, prog, mem.gpio_count, mem.gpio_underflow);  // clear previous count and underflow count
+	softio_prog_reset_fifo(sio, prog, mem.fifo0);  // reset fifo0
+	softio_prog_write_between(sio, prog, mem.tim1_IT, mem.tim1_period);  // start timer
+	softio_delay(upload, sio, prog);
+	softio_blocking(run, sio, prog);
 	fifo_clear(&mem.fifo0);
-	float actual = Timer_Start_IT(1, frequency);  // start timer
 	if (verbose) printf("GPIO streaming frequency: %f kHz\n", actual/1e3);
 	// first fill the fifo
 	uint32_t written_cnt = 0;  // the length of sent
@@ -252,7 +331,7 @@ void SoftF103Host_t::GPIO_streaming(float frequency, vector<uint8_t> samples) {
 	softio_blocking(write, sio, mem.gpio_count);  // write count variable to start transmitting
 	while (written_cnt < samples.size()) {
 		// printf("mem.fifo0.length: %d, samples.size(): %d, mem.gpio_count: %d, written_cnt: %d\n", __FIFO_GET_LENGTH(&mem.fifo0), samples.size(), mem.gpio_count, written_cnt);
-		uint32_t write_len = __FIFO_GET_LENGTH(&mem.fifo0) - 1 + samples.size() - mem.gpio_count - written_cnt;  // maximum write without overflow
+		uint32_t write_len = fifo_capacity(&mem.fifo0) + samples.size() - mem.gpio_count - written_cnt;  // maximum write without overflow
 		write_len = min(write_len, (uint32_t)(samples.size() - written_cnt));  // cannot exceed remained samples
 		if (verbose) printf("[%d/%d] stream %d samples\n", (int)(samples.size() - mem.gpio_count), (int)samples.size(), (int)write_len);
 		for (uint32_t i=0; i<write_len; ++i) {
@@ -263,11 +342,18 @@ void SoftF103Host_t::GPIO_streaming(float frequency, vector<uint8_t> samples) {
 			softio_delay(write_fifo, sio, mem.fifo0);  // fill the remote fifo
 		}
 		softio_delay_flush_try(read_between, sio, mem.gpio_count, mem.gpio_underflow);
-		this_thread::sleep_for(chrono::milliseconds(1));
+		if (!sio.credit_capacity) this_thread::sleep_for(chrono::milliseconds(1));  // otherwise throttled by credits
 		assert(mem.gpio_underflow == 0 && "tx underflow occurs, may be system overloaded or frequency too high");
 	}
 	// waiting for stop
-	while (1) {
+	if (sio.features & SOFTIO_FEATURE_PUSH) {  // MCU pushes gpio_count when it changes, at most every 100ms
+		softio_blocking(subscribe, sio, 0, mem.gpio_count, 100, SOFTIO_SUB_ON_CHANGE);
+		while (mem.gpio_count) {
+			if (verbose) printf("[%d/%d] waiting %d samples\n", (int)(samples.size() - mem.gpio_count), (int)samples.size(), mem.gpio_count);
+			softio_wait_frame(sio);
+		}
+		softio_blocking(unsubscribe, sio, 0);
+	} else while (1) {
 		softio_blocking(read, sio, mem.gpio_count);
 		if (mem.gpio_count == 0) break;
 		if (verbose) printf("[%d/%d] waiting %d samples\n", (int)(samples.size() - mem.gpio_count), (int)samples.size(), mem.gpio_count);
@@ -277,52 +363,67 @@ void SoftF103Host_t::GPIO_streaming(float frequency, vector<uint8_t> samples) {
 
 float SoftF103Host_t::ADC_read(int adc) {
 	assert((adc == 1 || adc == 2 ) && "invalid adc number");
-	if (adc == 1) {
-		softio_blocking(read, sio, mem.adc1);
-		return 3.3 * mem.adc1 / 4096.;
-	} else {
-		softio_blocking(read, sio, mem.adc2);
-		return 3.3 * mem.adc2 / 4096.;
-	}
+	auto& value = adc == 1 ? mem.adc1 : mem.adc2;
+	uint32_t tag = softio_delay_read_tagged(sio, value);  // MCU defers it until converted, without holding other transactions
+	softio_flush(sio);
+	softio_wait_tag(sio, tag);
+	return 3.3 * value / 4096.;
 }
 
 pair<float, float> SoftF103Host_t::ADC_read_both() {
-	softio_blocking(read_between, sio, mem.adc1, mem.adc2);
+	uint32_t tag = softio_delay_read_tagged_between(sio, mem.adc1, mem.adc2);
+	softio_flush(sio);
+	softio_wait_tag(sio, tag);
 	return make_pair(3.3 * mem.adc1 / 4096., 3.3 * mem.adc2 / 4096.);
 }
 
 vector<pair<float, float>> SoftF103Host_t::ADC_streaming(float frequency, int length) {
+	bool push = sio.features & SOFTIO_FEATURE_PUSH;  // MCU drains fifo1 by itself, no polling round trip
 	// assert(frequency > 0 && frequency <= 50e3 && "ADC clock = 12MHz, sampling time = 239.5 cycles => 50kHz max (cannot reach due to small fifo length)");
-	assert(frequency > 0 && frequency <= 20e3 && "experimental maximum speed");
+	assert(frequency > 0 && frequency <= (push ? 50e3 : 20e3) && "experimental maximum speed");
 	assert(length > 0);
 	mem.adc_count = 0;
 	mem.adc_overflow = 0;
-	softio_blocking(write_between, sio, mem.adc_count, mem.adc_overflow);  // clear previous count and overflow count
-	softio_blocking(reset_fifo, sio, mem.fifo1);  // reset fifo1
+	mem.adc_packed = 1;  // 3 byte per sample instead of 4, fifo1 holds 341 samples rather than 255
+	float actual = Timer_Set_IT(1, frequency);
+	softio_prog_init(sio, prog, mem.program_buf);  // the whole setup in a single exchange
+	softio_prog_write_between(sio, prog, mem.adc_count, mem.adc_packed);  // clear previous count and overflow count
+	softio_prog_reset_fifo(sio, prog, mem.fifo1);  // reset fifo1
+	softio_prog_write_between(sio, prog, mem.tim1_IT, mem.tim1_period);  // start timer
+	softio_delay(upload, sio, prog);
+	softio_blocking(run, sio, prog);
 	fifo_clear(&mem.fifo1);
-	float actual = Timer_Start_IT(1, frequency);  // start timer
 	if (verbose) printf("ADC streaming frequency: %f kHz\n", actual/1e3);
+	if (push) {
+		softio_delay_subscribe_fifo(sio, 1, mem.fifo1, 252, 1);  // 84 * 3byte data at most every 1ms
+		softio_delay_subscribe(sio, 2, mem.adc_overflow, 10, SOFTIO_SUB_ON_CHANGE);
+	}
 	mem.adc_count = length;
 	softio_delay(write, sio, mem.adc_count);  // write count variable to start receiving
 	int recv_length = 0;
 	vector<pair<float, float>> samples;
+	char packed[sizeof(mem.fifo1_buf)];
+	float values[2 * sizeof(mem.fifo1_buf) / PACK12_PAIR_SIZE];
 	while (recv_length < length) {
 		// printf("mem.fifo0.length: %d, samples.size(): %d, mem.gpio_count: %d, written_cnt: %d\n", __FIFO_GET_LENGTH(&mem.fifo0), samples.size(), mem.gpio_count, written_cnt);
-		softio_delay(read, sio, mem.adc_overflow);
-		softio_blocking(read_fifo_part, sio, mem.fifo1, 252);  // 63 * 4byte data
-		assert(mem.adc_overflow == 0 && "rx overflow occurs, may be system overloaded or frequency too high");
-		assert(fifo_count(&mem.fifo1) % 4 == 0);
-		int has_samples = fifo_count(&mem.fifo1) / 4;
-		while (!fifo_empty(&mem.fifo1)) {
-			uint16_t adc1 = (uint8_t)fifo_deque(&mem.fifo1);
-			adc1 |= ((uint16_t)(uint8_t)fifo_deque(&mem.fifo1)) << 8;
-			uint16_t adc2 = (uint8_t)fifo_deque(&mem.fifo1);
-			adc2 |= ((uint16_t)(uint8_t)fifo_deque(&mem.fifo1)) << 8;
-			samples.push_back(make_pair(3.3 * adc1 / 4096., 3.3 * adc2 / 4096.));
-			recv_length += 1;
+		if (push) softio_wait_frame(sio);
+		else {
+			softio_delay(read, sio, mem.adc_overflow);
+			softio_blocking(read_fifo_part, sio, mem.fifo1, 252);  // 84 * 3byte data
 		}
-		if (verbose) printf("[%d/%d] stream %d samples\n", (int)(samples.size()), length, has_samples);
-		if (actual < 5e3) this_thread::sleep_for(chrono::milliseconds(1));
+		assert(mem.adc_overflow == 0 && "rx overflow occurs, may be system overloaded or frequency too high");
+		assert(fifo_count(&mem.fifo1) % PACK12_PAIR_SIZE == 0);
+		int has_samples = fifo_count(&mem.fifo1) / PACK12_PAIR_SIZE;
+		fifo_move_to_buffer(packed, &mem.fifo1, has_samples * PACK12_PAIR_SIZE);
+		pack12_unpack_float(values, packed, has_samples, 3.3 / 4096.);
+		for (int i=0; i<has_samples; ++i) samples.push_back(make_pair(values[2*i], values[2*i+1]));
+		recv_length += has_samples;
+		if (verbose && has_samples) printf("[%d/%d] stream %d samples\n", (int)(samples.size()), length, has_samples);
+		if (!push && actual < 5e3 && !sio.credit_capacity) this_thread::sleep_for(chrono::milliseconds(1));
+	}
+	if (push) {
+		softio_delay_unsubscribe(sio, 1);
+		softio_delay_unsubscribe(sio, 2);
 	}
 	softio_blocking(read_between, sio, mem.adc_count, mem.adc_overflow);
 	assert(mem.adc_count == 0 && "strange, should not be here");
@@ -0,0 +1,156 @@
+#define SOFTIO_USE_FUNCTION
+#include "softf103.h"
+#include <chrono>
+#include <random>
+#include <string>
+#include <algorithm>
+
+// SoftF103 simulated on host, for tests without a board: memory and main loop like SoftF103-MCU, with USB packets handled in place
+// (see usb_fifo_receive). TIM1 interrupt streams GPIO from fifo0 and ADC samples into fifo1 at its frequency, gpio_in reads gpio_out
+// back and ADC gives a ramp. it has no transport: bytes from host go to receive, and replies come from transmit. bit flips could be
+// injected on both directions, to test resync (see __softio_error). a host in the same process could talk to it by attach
+
+#define SOFTF103_SIM_PACKET 64  // USB full speed bulk packet
+
+struct SoftF103_Sim_t {
+	SoftF103_Mem_t mem;
+	SoftIO_t sio;
+	SoftIO_Hook_t hooks[4];
+	char packet[SOFTF103_SIM_PACKET];  // received, handled in place until all is taken
+	uint32_t packet_length;  // 0 if none
+	uint32_t packet_taken;
+	double tim1_due;  // TIM1 updates to be simulated
+	uint32_t corrupt;  // flip a random bit in one of `corrupt` bytes received or transmitted on average, 0 for none
+	uint32_t flips;  // bits flipped
+	std::string replies;  // transmitted to an attached host, not got by it yet
+	std::minstd_rand random;
+	std::chrono::steady_clock::time_point start, last;
+	SoftF103_Sim_t();
+	SoftF103_Sim_t(const SoftF103_Sim_t&) = delete;  // sio points into mem
+	uint32_t receive(const char* buf, uint32_t length);  // like CDC_Receive_FS, return bytes taken, 0 until the last packet is handled
+	void loop();  // a round of the main loop, then interrupts since the last round
+	uint32_t transmit(char* buf, uint32_t max_length);  // like usb_fifo_transmit, return bytes sent
+	uint32_t tick();  // ms, like HAL_GetTick
+	uint16_t adc_value(int adc);
+	void tim1_update();  // like TIM1_UP_IRQHandler, ADC converts at once
+	void corrupt_bytes(char* buf, uint32_t length);
+	void attach(SoftIO_t& host);  // gets and puts of host run the main loop in place, gets returns 0 like the timeout of a port
+	void step();  // loop, then transmit into replies
+};
+
+#ifdef SOFTF103SIM_IMPLEMENTATION
+#undef SOFTF103SIM_IMPLEMENTATION
+
+SoftF103_Sim_t::SoftF103_Sim_t() {
+	memset(&mem, 0, sizeof(mem));
+	mem.status = STATUS_INIT;  // like memory_init_user_code_begin_sys_init
+	mem.version = MCU_VERSION;
+	mem.pid = MCU_PID;
+	mem.mem_size = sizeof(SoftF103_Mem_t);
+	mem.softio_features = SOFTIO_FEATURES;
+	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
+	start = last = std::chrono::steady_clock::now();
+	sio.tick = [&]()->uint32_t { return tick(); };
+	softio_set_hooks(sio, hooks, sizeof(hooks) / sizeof(hooks[0]));
+	softio_hook(sio, mem.gpio_in, SOFTIO_HOOK_ON_READ, [&](void*, SoftIO_Head_t*) { mem.gpio_in = mem.gpio_out; }, NULL);
+	softio_hook(sio, mem.adc1, SOFTIO_HOOK_ON_READ, [&](void*, SoftIO_Head_t*) { mem.adc1 = adc_value(1); }, NULL);
+	softio_hook(sio, mem.adc2, SOFTIO_HOOK_ON_READ, [&](void*, SoftIO_Head_t*) { mem.adc2 = adc_value(2); }, NULL);
+	packet_length = 0;
+	packet_taken = 0;
+	tim1_due = 0;
+	corrupt = 0;
+	flips = 0;
+}
+
+uint32_t SoftF103_Sim_t::receive(const char* buf, uint32_t length) {
+	if (packet_length) return 0;  // endpoint not re-armed, host is NAKed
+	if (length > sizeof(packet)) length = sizeof(packet);
+	memcpy(packet, buf, length);
+	corrupt_bytes(packet, length);
+	packet_length = length;
+	packet_taken = 0;
+	return length;
+}
+
+void SoftF103_Sim_t::loop() {
+	if (packet_length) {  // usb_fifo_receive. the rest is copied to stack, so that a view of it is in reach (see fifo_in_reach)
+		char rest[SOFTF103_SIM_PACKET];
+		memcpy(rest, packet + packet_taken, packet_length - packet_taken);
+		packet_taken += softio_receive(sio, rest, packet_length - packet_taken);
+		if (packet_taken == packet_length) packet_length = 0;
+	}
+	softio_try_handle_all(sio);
+	auto now = std::chrono::steady_clock::now();
+	if (mem.tim1_IT && mem.tim1_period) {
+		tim1_due += std::chrono::duration<double>(now - last).count() * 72e6 / (mem.tim1_prescaler + 1.) / mem.tim1_period;
+		for (; tim1_due >= 1; tim1_due -= 1) tim1_update();
+	} else tim1_due = 0;
+	last = now;
+}
+
+uint32_t SoftF103_Sim_t::transmit(char* buf, uint32_t max_length) {
+	uint32_t length = fifo_move_to_buffer(buf, &mem.siotx, max_length);
+	corrupt_bytes(buf, length);
+	return length;
+}
+
+uint32_t SoftF103_Sim_t::tick() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+uint16_t SoftF103_Sim_t::adc_value(int adc) {
+	return (tick() * (adc == 1 ? 1 : 3)) & 0xFFF;
+}
+
+void SoftF103_Sim_t::tim1_update() {
+	if (mem.gpio_count) {
+		--mem.gpio_count;
+		if (fifo1k_empty(&mem.fifo0)) ++mem.gpio_underflow;  // main loop fills it
+		else mem.gpio_out = fifo1k_deque(&mem.fifo0);
+	}
+	if (mem.adc_count) {  // HAL_ADC_ConvCpltCallback of both
+		--mem.adc_count;
+		uint16_t adc1 = adc_value(1), adc2 = adc_value(2);
+		if (fifo1k_remain(&mem.fifo1) < (mem.adc_packed ? PACK12_PAIR_SIZE : 4)) ++mem.adc_overflow;  // main loop drains it
+		else if (mem.adc_packed) pack12_enque(&mem.fifo1, adc1, adc2);
+		else {
+			char sample[4] = { (char)adc1, (char)(adc1 >> 8), (char)adc2, (char)(adc2 >> 8) };
+			fifo1k_put(&mem.fifo1, sample, 4);
+		}
+	}
+}
+
+void SoftF103_Sim_t::attach(SoftIO_t& host) {
+	host.puts = [this](char *buffer, size_t size)->size_t {
+		uint32_t n = receive(buffer, size);
+		for (int rounds = 0; n == 0 && rounds < 1000; ++rounds) {  // slave is busy with the last packet
+			step();
+			n = receive(buffer, size);
+		}
+		return n;
+	};
+	host.gets = [this](char *buffer, size_t size)->size_t {
+		for (int rounds = 0; replies.empty() && rounds < 1000; ++rounds) step();
+		size_t n = std::min(size, replies.size());
+		memcpy(buffer, replies.data(), n);
+		replies.erase(0, n);
+		return n;
+	};
+}
+
+void SoftF103_Sim_t::step() {
+	loop();
+	char buf[SOFTF103_SIM_PACKET];
+	uint32_t n = transmit(buf, sizeof(buf));
+	replies.append(buf, n);
+}
+
+void SoftF103_Sim_t::corrupt_bytes(char* buf, uint32_t length) {
+	if (!corrupt) return;
+	for (uint32_t i=0; i<length; ++i) if (random() % corrupt == 0) {
+		buf[i] ^= 1 << (random() % 8);
+		++flips;
+	}
+}
+
+#endif
@@ -1,5 +1,6 @@
 #include "fifo.h"
 #include "softio.h"
+#include "pack12.h"
 
 /*
  * This header library provides basic functions for MCU operation
@@ -7,7 +8,7 @@
  */
 
 // MCU_VERSION: uint32_t number, like 0x19052200, be sure to update this number when memory is different from before
-#define MCU_VERSION 0x19112500
+#define MCU_VERSION 0x26101703
 // MCU_PID: uint16_t number, the pid to distinguish different devices, you should modify it, for example:
 #define MCU_PID 0x1234
 
@@ -44,21 +45,22 @@ typedef struct {
 
 	uint32_t mem_size;  // sizeof(SoftF103_Mem_t)
 
+	uint32_t softio_features;  // SOFTIO_FEATURES of MCU, host reads it at handshake to enable protocol extensions. keep it at offset 12, 0 for none
+
 	uint16_t siorx_overflow;
 
 // GPIO functions
 	uint8_t gpio_out;  // write to this variable will immediately update GPIO value of PB0 ~ PB7
 	uint8_t gpio_in;  // read PB8 ~ PB15
-	uint32_t gpio_count_add;  // write to atomically add to gpio_count
-	uint32_t gpio_count;  // for data streaming, provide the count of samples. only when timer 1 interrupt is valid, and using fifo0
+	uint32_t gpio_count;  // for data streaming, provide the count of samples. only when timer 1 interrupt is valid, and using fifo0. host adds to it atomically by softio_delay_fetch_add
 	uint32_t gpio_underflow;  // record underflow count for sanity check
 
 // read adc value immediately
 	uint16_t adc1;
 	uint16_t adc2;
-	uint32_t adc_count_add;  // write to atomically add to adc_count
-	uint32_t adc_count;  // for data streaming, provide the count of samples. only when timer 1 interrupt is valid, and using fifo1. Writing a non-zero value to this variable will call HAL_ADC_Start_IT, and when adc_count decreases to zero, it will call HAL_ADC_Stop_IT
+	uint32_t adc_count;  // for data streaming, provide the count of samples. only when timer 1 interrupt is valid, and using fifo1. host adds to it atomically by softio_delay_fetch_add. Writing a non-zero value to this variable will call HAL_ADC_Start_IT, and when adc_count decreases to zero, it will call HAL_ADC_Stop_IT
 	uint32_t adc_overflow;  // record overflow count for sanity check
+	uint8_t adc_packed;  // write 1 to store samples in fifo1 as 3 byte packed pairs (see pack12.h) instead of 4 byte
 
 // LED functions
 	uint8_t led;  // write 1 to open the LED and write 0 to close. only the LSB is used
@@ -78,17 +80,20 @@ typedef struct {
 	uint16_t tim2_period;
 	uint16_t tim2_pulse;
 
+// stored programs
+	char program_buf[128];  // host builds setup sequences here and runs them in a single exchange, see SOFTIO_EXT_RUN
+
 	char siorx_buf[1024];
 	char siotx_buf[1024];
 	char logging_buf[512];  // debug informations here
-	char fifo0_buf[1024];
+	char fifo0_buf[1024];  // power of 2 fifos, accessed by fifo1k_xxx in interrupts
 	char fifo1_buf[1024];
 #define Mem_FifoInit(mem) do {\
 	FIFO_STD_INIT(mem, siorx);\
 	FIFO_STD_INIT(mem, siotx);\
 	FIFO_STD_INIT(mem, logging);\
-	FIFO_STD_INIT(mem, fifo0);\
-	FIFO_STD_INIT(mem, fifo1);\
+	FIFO_POW2_STD_INIT(mem, fifo0);\
+	FIFO_POW2_STD_INIT(mem, fifo1);\
 } while(0)
 	Fifo_t siorx;  // must be the first 
 	Fifo_t siotx;
@@ -97,6 +102,7 @@ typedef struct {
 	Fifo_t fifo1;
 
 } SoftF103_Mem_t;
+FIFO_POW2_FUNCTIONS(fifo1k, 1024)  // of fifo0 and fifo1
 
 #define print_debug(format, ...) do { if (VERBOSE_REACH_LEVEL(mem.verbose_level, VERBOSE_DEBUG))    printf("D: " format "\r\n",##__VA_ARGS__); } while(0)
 #define print_info(format, ...) do { if (VERBOSE_REACH_LEVEL(mem.verbose_level, VERBOSE_INFO))      printf("I: " format "\r\n",##__VA_ARGS__); } while(0)
@@ -119,6 +125,7 @@ void memory_init_user_code_begin_sys_init(void) {
     mem.pid = MCU_PID;
 	mem.verbose_level = VERBOSE_DEBUG;  // set verbose level
 	mem.mem_size = sizeof(SoftF103_Mem_t);
+	mem.softio_features = SOFTIO_FEATURES;
 	SOFTIO_QUICK_INIT(sio, mem, Mem_FifoInit);
 }
 #endif
@@ -4,96 +4,136 @@
 #include <stdint.h>
 #include <math.h>
 #include <string.h>
+#include "assert.h"
 
 #if __SIZEOF_POINTER__ == 8
-typedef struct {
-    char* base;
-    uint32_t length;
-} fifo_base_length_t;
-#include "assert.h"
 #include "stdio.h"
-// #define FIFO_PTR(base) ((char*)((long long)(base)))
-// #define FIFO_BASE(ptr) ((uint32_t)((long long)(ptr)))
-#define __FIFO_GET_PTR8(fifo) ((fifo_base_length_t*)((fifo)->__L + (((long long)(fifo)->__H) << 32)))
-#define __FIFO_SET_LENGTH(fifo, length) __FIFO_GET_PTR8(fifo)->length = (length)
-#define __FIFO_SET_BASE(fifo, base) __FIFO_GET_PTR8(fifo)->base = (base)
-#define __FIFO_GET_LENGTH(fifo) (__FIFO_GET_PTR8(fifo)->length)
-#define __FIFO_GET_BASE(fifo) (__FIFO_GET_PTR8(fifo)->base)
-#else
-// #define FIFO_PTR(base) ((char*)(base))
-// #define FIFO_BASE(ptr) ((uint32_t)(ptr))
+#include "stdlib.h"
+#endif
+
+/* base is the offset of buffer from the fifo itself, so the header is the same on MCU and host and never points out of the memory block
+ * holding both: the block could be copied, mmapped or saved as a whole, and a fifo read from remote is valid locally.
+ * a copy of Fifo_t alone (outside of the block) must not be used to access data. on 64-bit the buffer must be within 2 GiB, see fifo_in_reach
+ */
 #define __FIFO_SET_LENGTH(fifo, length) (fifo)->length = (length)
-#define __FIFO_SET_BASE(fifo, base) (fifo)->base = (uint32_t)(base)
+#define __FIFO_SET_BASE(fifo, base) (fifo)->base = (int32_t)((intptr_t)(base) - (intptr_t)(fifo))
 #define __FIFO_GET_LENGTH(fifo) ((fifo)->length)
-#define __FIFO_GET_BASE(fifo) ((char*)((fifo)->base))
-#endif
+#define __FIFO_GET_BASE(fifo) ((char*)(fifo) + (fifo)->base)
+
+// flag in length: the length is a power of 2 and read, write are free running, so all bytes are usable and positions are masked, not divided.
+// fifo_xxx functions handle both kinds, so remote fifo operations work on either. FIFO_POW2_FUNCTIONS skips the check when length is known
+#define FIFO_POW2 0x80000000u
+// flag in length: the buffer is followed by a mapping of itself (see softio-mirror.h), so data and space are contiguous from any position
+#define FIFO_MIRROR 0x40000000u
+#define FIFO_FLAGS (FIFO_POW2 | FIFO_MIRROR)
 
 #if defined(__cplusplus)
 struct Fifo_t {
 #else
 typedef struct {
 #endif
-#if __SIZEOF_POINTER__ == 8
-    uint32_t __L;
-    uint32_t __H;
-#else
-    uint32_t base;  // base pointer
+    int32_t base;  // offset of buffer from this fifo
     uint32_t length;  // length of this fifo
-#endif
     uint32_t read;
     uint32_t write;
-#if __SIZEOF_POINTER__ == 8
 #if defined(__cplusplus)
-    uint32_t Length() { return __FIFO_GET_LENGTH(this); }
+    uint32_t Length() { return __FIFO_GET_LENGTH(this) & ~FIFO_FLAGS; }
     char* Base() { return __FIFO_GET_BASE(this); }
-    Fifo_t() { fifo_base_length_t* ptr = new fifo_base_length_t; __L = ((long long)ptr); __H = ((long long)ptr) >> 32; }
-    ~Fifo_t() { delete __FIFO_GET_PTR8(this); }
-#else
-#error memory leak will happen in 64-bit C program, please use C++ instead
-#endif
-#endif
-#if defined(__cplusplus)
 };
 #else
 } Fifo_t;
 #endif
 
-#if __SIZEOF_POINTER__ == 8
-static inline void fifo_destroy(Fifo_t* fifo) { delete __FIFO_GET_PTR8(fifo); }  // do not call this will cause memory leak
-#else
-static inline void fifo_destroy(Fifo_t* fifo) {}  // do nothing
-#endif
+static inline void fifo_destroy(Fifo_t* fifo) { (void)fifo; }  // do nothing, nothing is allocated
+
+// whether fifo could use a buffer at base, always true on 32-bit
+static inline char fifo_in_reach(Fifo_t* fifo, const char* base) {
+    intptr_t offset = (intptr_t)base - (intptr_t)fifo;
+    return offset == (int32_t)offset;
+}
 
 // if you use a parent struct that contains fifo "name" and also buffer named "name"_buf, this could be used to initialize it
 #define FIFO_STD_INIT(parent, name) fifo_init(&(parent.name), parent.name##_buf, sizeof(parent.name##_buf))
+#define FIFO_POW2_STD_INIT(parent, name) fifo_init_pow2(&(parent.name), parent.name##_buf, sizeof(parent.name##_buf))
 
 static inline void fifo_init(Fifo_t* fifo, char* base, uint32_t length) {
-// there is risk to convert 64bit pointer to 32bit fifo_ptr, so sanity check is done on 64bit program
+#if __SIZEOF_POINTER__ == 8
+    if (!fifo_in_reach(fifo, base)) {  // base would be truncated, so it's checked without NDEBUG as well
+        fprintf(stderr, "buffer %p too far away from fifo %p, see fifo_in_reach\n", (void*)base, (void*)fifo);
+        abort();
+    }
+#endif
     __FIFO_SET_BASE(fifo, base);
     __FIFO_SET_LENGTH(fifo, length);
     fifo->read = 0;
     fifo->write = 0;
 }
 
+// length must be a power of 2, and all of them are usable
+static inline void fifo_init_pow2(Fifo_t* fifo, char* base, uint32_t length) {
+    assert(length && !(length & (length - 1)) && "length of pow2 fifo is not a power of 2");
+    fifo_init(fifo, base, length | FIFO_POW2);
+}
+
+// length is a power of 2 and base is followed by a mapping of the same length
+static inline void fifo_init_mirror(Fifo_t* fifo, char* base, uint32_t length) {
+    fifo_init(fifo, base, length | FIFO_POW2 | FIFO_MIRROR);
+}
+
+// bytes of buffer
+static inline uint32_t __fifo_size(Fifo_t* fifo) {
+    return __FIFO_GET_LENGTH(fifo) & ~FIFO_FLAGS;
+}
+
+// position in buffer of read or write
+static inline uint32_t __fifo_pos(Fifo_t* fifo, uint32_t pointer) {
+    uint32_t length = __FIFO_GET_LENGTH(fifo);
+    return (length & FIFO_POW2) ? pointer & ((length & ~FIFO_FLAGS) - 1) : pointer;
+}
+
+// bytes that could be accessed from position without wrapping
+static inline uint32_t __fifo_contiguous(Fifo_t* fifo, uint32_t pos) {
+    uint32_t length = __FIFO_GET_LENGTH(fifo);
+    return (length & FIFO_MIRROR) ? length & ~FIFO_FLAGS : (length & ~FIFO_FLAGS) - pos;
+}
+
+// read or write moved by n, n <= length
+static inline uint32_t __fifo_next(Fifo_t* fifo, uint32_t pointer, uint32_t n) {
+    uint32_t length = __FIFO_GET_LENGTH(fifo);
+    return (length & FIFO_POW2) ? pointer + n : (pointer + n) % length;
+}
+
+// bytes from read to write
+static inline uint32_t __fifo_distance(Fifo_t* fifo, uint32_t read, uint32_t write) {
+    uint32_t length = __FIFO_GET_LENGTH(fifo);
+    return (length & FIFO_POW2) ? write - read : (write - read + length) % length;
+}
+
+// at most this many bytes could be in it
+static inline uint32_t fifo_capacity(Fifo_t* fifo) {
+    uint32_t length = __FIFO_GET_LENGTH(fifo);
+    return (length & FIFO_POW2) ? length & ~FIFO_FLAGS : length - 1;
+}
+
 // not safe when fifo is full
 static inline void fifo_enque(Fifo_t* fifo, char c) {
-    __FIFO_GET_BASE(fifo)[fifo->write] = c;
-    fifo->write = (fifo->write + 1) % __FIFO_GET_LENGTH(fifo);
+    __FIFO_GET_BASE(fifo)[__fifo_pos(fifo, fifo->write)] = c;
+    fifo->write = __fifo_next(fifo, fifo->write, 1);
 }
 
 // not safe when fifo is empty
 static inline char fifo_deque(Fifo_t* fifo) {
-    char c = __FIFO_GET_BASE(fifo)[fifo->read];
-    fifo->read = (fifo->read + 1) % __FIFO_GET_LENGTH(fifo);
+    char c = __FIFO_GET_BASE(fifo)[__fifo_pos(fifo, fifo->read)];
+    fifo->read = __fifo_next(fifo, fifo->read, 1);
     return c;
 }
 
 static inline char fifo_preread(Fifo_t* fifo, uint32_t index) {  // read at (read+index)%length
-    return __FIFO_GET_BASE(fifo)[(fifo->read + index) % __FIFO_GET_LENGTH(fifo)];
+    return __FIFO_GET_BASE(fifo)[__fifo_pos(fifo, __fifo_next(fifo, fifo->read, index))];
 }
 
 static inline char fifo_full(Fifo_t* fifo) {
-    return (fifo->write + 1) % __FIFO_GET_LENGTH(fifo) == fifo->read;
+    return __fifo_distance(fifo, fifo->read, fifo->write) == fifo_capacity(fifo);
 }
 
 static inline char fifo_empty(Fifo_t* fifo) {
@@ -106,39 +146,32 @@ static inline void fifo_clear(Fifo_t* fifo) {
 
 // return the count of data in the buffer, however, not consistant because of no lock
 static inline uint32_t fifo_count(Fifo_t* fifo) {
-    return (fifo->write - fifo->read + __FIFO_GET_LENGTH(fifo)) % __FIFO_GET_LENGTH(fifo);
+    return __fifo_distance(fifo, fifo->read, fifo->write);
 }
 #define fifo_data_count(fifo) fifo_count(fifo)  // deprecated
 
 static inline uint32_t fifo_remain(Fifo_t* fifo) {
-    return __FIFO_GET_LENGTH(fifo) - ((fifo->write - fifo->read + __FIFO_GET_LENGTH(fifo)) % __FIFO_GET_LENGTH(fifo)) - 1;
-}
-
-// move data from src to dest with maximum length of max_length, return the byte count moved
-static inline uint32_t fifo_move(Fifo_t* dest, Fifo_t* src, uint32_t max_length) {
-    uint32_t i;
-    for (i=0; i<max_length && !fifo_empty(src) && !fifo_full(dest); ++i) fifo_enque(dest, fifo_deque(src));
-    return i;
+    return fifo_capacity(fifo) - __fifo_distance(fifo, fifo->read, fifo->write);
 }
 
 static inline char* __fifo_read_base(Fifo_t* fifo) {
-    return __FIFO_GET_BASE(fifo) + fifo->read;
+    return __FIFO_GET_BASE(fifo) + __fifo_pos(fifo, fifo->read);
 }
 
 static inline uint32_t __fifo_read_base_length(Fifo_t* fifo) {
-    return __FIFO_GET_LENGTH(fifo) - fifo->read;
+    return __fifo_contiguous(fifo, __fifo_pos(fifo, fifo->read));
 }
 
 static inline char* __fifo_write_base(Fifo_t* fifo) {
-    return __FIFO_GET_BASE(fifo) + fifo->write;
+    return __FIFO_GET_BASE(fifo) + __fifo_pos(fifo, fifo->write);
 }
 
 static inline uint32_t __fifo_write_base_length(Fifo_t* fifo) {
-    return __FIFO_GET_LENGTH(fifo) - fifo->write;
+    return __fifo_contiguous(fifo, __fifo_pos(fifo, fifo->write));
 }
 
 static inline void __fifo_fullfill(Fifo_t* fifo) {  // useful for testing speed
-    fifo->write = (fifo->read + __FIFO_GET_LENGTH(fifo) - 1) % __FIFO_GET_LENGTH(fifo);
+    fifo->write = __fifo_next(fifo, fifo->read, fifo_capacity(fifo));
 }
 
 // move data from src to dest with maximum length of max_length, return the byte count moved
@@ -152,7 +185,7 @@ static inline uint32_t fifo_move_to_buffer(char* dest, Fifo_t* src, uint32_t max
         memcpy(dest, __fifo_read_base(src), len);
         memcpy(dest + len, __FIFO_GET_BASE(src), copylen - len);
     }
-    src->read = (src->read + copylen) % __FIFO_GET_LENGTH(src);  // set pointer directly
+    src->read = __fifo_next(src, src->read, copylen);  // set pointer directly
     return copylen;
 }
 
@@ -167,13 +200,248 @@ static inline uint32_t fifo_copy_from_buffer(Fifo_t* dest, const char* src, uint
         memcpy(__fifo_write_base(dest), src, len);
         memcpy(__FIFO_GET_BASE(dest), src + len, copylen - len);
     }
-    dest->write = (dest->write + copylen) % __FIFO_GET_LENGTH(dest);  // set pointer directly
+    dest->write = __fifo_next(dest, dest->write, copylen);  // set pointer directly
     return copylen;
 }
 
+// copy data at (read+index)%length to dest without moving read pointer, not safe when count < index + length
+static inline void fifo_peek_to_buffer(char* dest, Fifo_t* src, uint32_t index, uint32_t length) {
+    uint32_t start = __fifo_pos(src, __fifo_next(src, src->read, index));
+    uint32_t len = __fifo_contiguous(src, start);
+    if (len >= length) {  // copy once OK
+        memcpy(dest, __FIFO_GET_BASE(src) + start, length);
+    } else {  // need slicing
+        memcpy(dest, __FIFO_GET_BASE(src) + start, len);
+        memcpy(dest + len, __FIFO_GET_BASE(src), length - len);
+    }
+}
+
+// drop length bytes, not safe when count < length
+static inline void fifo_skip(Fifo_t* fifo, uint32_t length) {
+    fifo->read = __fifo_next(fifo, fifo->read, length);
+}
+
+/* single producer single consumer (SPSC) functions, for a fifo shared by an ISR and the main loop, or by two threads
+ * the producer only changes `write` and the consumer only changes `read`. each side publishes its pointer with a release store after
+ * touching the data, and loads the other one with an acquire load before. the layout is still Fifo_t, so remote fifo operations work on it
+ * functions above are fine for a fifo owned by one side
+ */
+static inline uint32_t __fifo_load_acquire(const uint32_t* ptr) {
+#if defined(__ARM_ARCH_PROFILE) && __ARM_ARCH_PROFILE == 'M'  // fences are DMB, the architecture doesn't keep normal accesses in order
+    uint32_t value = *(volatile const uint32_t*)ptr;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return value;
+#elif defined(__GNUC__)  // the builtins of C11 and C++11 atomics, on plain uint32_t
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#else  // e.g., MSVC, volatile has acquire and release semantics on x86
+    return *(volatile const uint32_t*)ptr;
+#endif
+}
+
+static inline void __fifo_store_release(uint32_t* ptr, uint32_t value) {
+#if defined(__ARM_ARCH_PROFILE) && __ARM_ARCH_PROFILE == 'M'
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    *(volatile uint32_t*)ptr = value;
+#elif defined(__GNUC__)
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#else
+    *(volatile uint32_t*)ptr = value;
+#endif
+}
+
+// either side, a snapshot
+static inline uint32_t fifo_spsc_count(Fifo_t* fifo) {
+    uint32_t read = __fifo_load_acquire(&fifo->read);
+    return __fifo_distance(fifo, read, __fifo_load_acquire(&fifo->write));
+}
+
+// producer, at least this many bytes could be put
+static inline uint32_t fifo_spsc_remain(Fifo_t* fifo) {
+    return fifo_capacity(fifo) - __fifo_distance(fifo, __fifo_load_acquire(&fifo->read), fifo->write);
+}
+
+static inline char fifo_spsc_full(Fifo_t* fifo) {
+    return __fifo_distance(fifo, __fifo_load_acquire(&fifo->read), fifo->write) == fifo_capacity(fifo);
+}
+
+// producer, not safe when fifo is full
+static inline void fifo_spsc_enque(Fifo_t* fifo, char c) {
+    __FIFO_GET_BASE(fifo)[__fifo_pos(fifo, fifo->write)] = c;
+    __fifo_store_release(&fifo->write, __fifo_next(fifo, fifo->write, 1));
+}
+
+// producer, all of the copied bytes are published at once
+static inline uint32_t fifo_spsc_copy_from_buffer(Fifo_t* dest, const char* src, uint32_t max_length) {
+    uint32_t copylen = fifo_spsc_remain(dest);
+    if (max_length < copylen) copylen = max_length;
+    uint32_t len = __fifo_write_base_length(dest);
+    if (len >= copylen) {  // copy once OK
+        memcpy(__fifo_write_base(dest), src, copylen);
+    } else {  // need slicing
+        memcpy(__fifo_write_base(dest), src, len);
+        memcpy(__FIFO_GET_BASE(dest), src + len, copylen - len);
+    }
+    __fifo_store_release(&dest->write, __fifo_next(dest, dest->write, copylen));
+    return copylen;
+}
+
+// consumer
+static inline char fifo_spsc_empty(Fifo_t* fifo) {
+    return fifo->read == __fifo_load_acquire(&fifo->write);
+}
+
+// consumer, not safe when fifo is empty
+static inline char fifo_spsc_deque(Fifo_t* fifo) {
+    char c = __FIFO_GET_BASE(fifo)[__fifo_pos(fifo, fifo->read)];
+    __fifo_store_release(&fifo->read, __fifo_next(fifo, fifo->read, 1));
+    return c;
+}
+
+// consumer, the space of moved bytes is released at once
+static inline uint32_t fifo_spsc_move_to_buffer(char* dest, Fifo_t* src, uint32_t max_length) {
+    uint32_t copylen = __fifo_distance(src, src->read, __fifo_load_acquire(&src->write));
+    if (max_length < copylen) copylen = max_length;
+    uint32_t len = __fifo_read_base_length(src);
+    if (len >= copylen) {  // copy once OK
+        memcpy(dest, __fifo_read_base(src), copylen);
+    } else {  // need slicing
+        memcpy(dest, __fifo_read_base(src), len);
+        memcpy(dest + len, __FIFO_GET_BASE(src), copylen - len);
+    }
+    __fifo_store_release(&src->read, __fifo_next(src, src->read, copylen));
+    return copylen;
+}
+
+// consumer, not safe when count < length
+static inline void fifo_spsc_skip(Fifo_t* fifo, uint32_t length) {
+    __fifo_store_release(&fifo->read, __fifo_next(fifo, fifo->read, length));
+}
+
+/* spans: data or free space of a fifo as at most two contiguous regions, so that they are processed in place, e.g., by memcpy
+ * fifo_read_spans / fifo_write_spans fill them and return the total, then fifo_read_commit / fifo_write_commit release or publish
+ * the bytes used. like fifo_spsc_xxx, read spans are taken by the consumer and write spans by the producer
+ */
+typedef struct {
+    char* ptr[2];
+    uint32_t len[2];
+} Fifo_Spans_t;
+
+static inline uint32_t __fifo_spans(Fifo_Spans_t* spans, Fifo_t* fifo, uint32_t pointer, uint32_t length) {
+    uint32_t start = __fifo_pos(fifo, pointer);
+    uint32_t len = __fifo_contiguous(fifo, start);
+    spans->ptr[0] = __FIFO_GET_BASE(fifo) + start;
+    spans->len[0] = len < length ? len : length;
+    spans->ptr[1] = __FIFO_GET_BASE(fifo);
+    spans->len[1] = length - spans->len[0];
+    return length;
+}
+
+// consumer, spans of at most max_length bytes of data
+static inline uint32_t fifo_read_spans(Fifo_t* fifo, Fifo_Spans_t* spans, uint32_t max_length) {
+    uint32_t length = __fifo_distance(fifo, fifo->read, __fifo_load_acquire(&fifo->write));
+    if (max_length < length) length = max_length;
+    return __fifo_spans(spans, fifo, fifo->read, length);
+}
+
+// consumer, release the first length bytes of read spans
+static inline void fifo_read_commit(Fifo_t* fifo, uint32_t length) {
+    fifo_spsc_skip(fifo, length);
+}
+
+// producer, spans of at most max_length bytes of free space
+static inline uint32_t fifo_write_spans(Fifo_t* fifo, Fifo_Spans_t* spans, uint32_t max_length) {
+    uint32_t length = fifo_spsc_remain(fifo);
+    if (max_length < length) length = max_length;
+    return __fifo_spans(spans, fifo, fifo->write, length);
+}
+
+// producer, publish the first length bytes of write spans
+static inline void fifo_write_commit(Fifo_t* fifo, uint32_t length) {
+    __fifo_store_release(&fifo->write, __fifo_next(fifo, fifo->write, length));
+}
+
+// copy length bytes from src spans to dest spans, at most three memcpy. not safe when either is shorter than length
+static inline void fifo_spans_copy(Fifo_Spans_t* dest, const Fifo_Spans_t* src, uint32_t length) {
+    uint32_t i = 0, j = 0, from = 0, to = 0;
+    while (length) {
+        uint32_t len = src->len[i] - from;
+        if (len > dest->len[j] - to) len = dest->len[j] - to;
+        if (len > length) len = length;
+        memcpy(dest->ptr[j] + to, src->ptr[i] + from, len);
+        from += len; to += len; length -= len;
+        if (from == src->len[i]) { ++i; from = 0; }
+        if (to == dest->len[j]) { ++j; to = 0; }
+    }
+}
+
+// move data from src to dest with maximum length of max_length, return the byte count moved
+static inline uint32_t fifo_move(Fifo_t* dest, Fifo_t* src, uint32_t max_length) {
+    Fifo_Spans_t from, to;
+    uint32_t length = fifo_read_spans(src, &from, max_length);
+    length = fifo_write_spans(dest, &to, length);
+    fifo_spans_copy(&to, &from, length);
+    fifo_write_commit(dest, length);
+    fifo_read_commit(src, length);
+    return length;
+}
+
+/* power of 2 fifo with length known at compile time, initialized by fifo_init_pow2 with the same length
+ * `FIFO_POW2_FUNCTIONS(fifo1k, 1024)` defines fifo1k_count, fifo1k_remain, fifo1k_full, fifo1k_empty, fifo1k_enque, fifo1k_deque and fifo1k_put,
+ * and `FifoPow2_t<1024>::enque(fifo, c)` is the same in C++. they only mask, without the flag check or a division, and have SPSC ordering
+ */
+static inline uint32_t __fifo_pow2_count(Fifo_t* fifo) {
+    uint32_t read = __fifo_load_acquire(&fifo->read);
+    return __fifo_load_acquire(&fifo->write) - read;
+}
+
+static inline uint32_t __fifo_pow2_remain(Fifo_t* fifo, uint32_t length) {  // producer
+    return length - (fifo->write - __fifo_load_acquire(&fifo->read));
+}
+
+static inline void __fifo_pow2_enque(Fifo_t* fifo, uint32_t length, char c) {  // producer, not safe when fifo is full
+    __FIFO_GET_BASE(fifo)[fifo->write & (length - 1)] = c;
+    __fifo_store_release(&fifo->write, fifo->write + 1);
+}
+
+static inline char __fifo_pow2_deque(Fifo_t* fifo, uint32_t length) {  // consumer, not safe when fifo is empty
+    char c = __FIFO_GET_BASE(fifo)[fifo->read & (length - 1)];
+    __fifo_store_release(&fifo->read, fifo->read + 1);
+    return c;
+}
+
+// producer, not safe when remain < size. all of them are published at once
+static inline void __fifo_pow2_put(Fifo_t* fifo, uint32_t length, const char* src, uint32_t size) {
+    uint32_t i;
+    for (i=0; i<size; ++i) __FIFO_GET_BASE(fifo)[(fifo->write + i) & (length - 1)] = src[i];
+    __fifo_store_release(&fifo->write, fifo->write + size);
+}
+
+#define FIFO_POW2_FUNCTIONS(prefix, length) \
+typedef char prefix##_length_is_power_of_2[(length) && !((length) & ((length) - 1)) ? 1 : -1]; \
+static inline uint32_t prefix##_count(Fifo_t* fifo) { return __fifo_pow2_count(fifo); } \
+static inline uint32_t prefix##_remain(Fifo_t* fifo) { return __fifo_pow2_remain(fifo, length); } \
+static inline char prefix##_full(Fifo_t* fifo) { return __fifo_pow2_remain(fifo, length) == 0; } \
+static inline char prefix##_empty(Fifo_t* fifo) { return fifo_spsc_empty(fifo); } \
+static inline void prefix##_enque(Fifo_t* fifo, char c) { __fifo_pow2_enque(fifo, length, c); } \
+static inline char prefix##_deque(Fifo_t* fifo) { return __fifo_pow2_deque(fifo, length); } \
+static inline void prefix##_put(Fifo_t* fifo, const char* src, uint32_t size) { __fifo_pow2_put(fifo, length, src, size); }
+
+#if defined(__cplusplus)
+template <uint32_t Length> struct FifoPow2_t {
+    static_assert(Length && !(Length & (Length - 1)), "length must be power of 2");
+    static uint32_t count(Fifo_t* fifo) { return __fifo_pow2_count(fifo); }
+    static uint32_t remain(Fifo_t* fifo) { return __fifo_pow2_remain(fifo, Length); }
+    static char full(Fifo_t* fifo) { return __fifo_pow2_remain(fifo, Length) == 0; }
+    static char empty(Fifo_t* fifo) { return fifo_spsc_empty(fifo); }
+    static void enque(Fifo_t* fifo, char c) { __fifo_pow2_enque(fifo, Length, c); }
+    static char deque(Fifo_t* fifo) { return __fifo_pow2_deque(fifo, Length); }
+    static void put(Fifo_t* fifo, const char* src, uint32_t size) { __fifo_pow2_put(fifo, Length, src, size); }
+};
+#endif
+
 #define fifo_dump(fifo) do {\
     uint32_t count = fifo_count(&fifo); \
-    printf("fifo \"%s\": base(%p), length(%d), read(%d), write(%d), has data(%d)\n", #fifo, __FIFO_GET_BASE(&fifo), __FIFO_GET_LENGTH(&fifo), fifo.read, fifo.write, count); \
+    printf("fifo \"%s\": base(%p), length(%d), read(%d), write(%d), has data(%d)\n", #fifo, __FIFO_GET_BASE(&fifo), __fifo_size(&fifo), fifo.read, fifo.write, count); \
     for (uint32_t i=0; i<count; i+=16) { \
         printf("  "); \
         for (uint32_t j=0; j<16 && j+i<count; ++j) printf(" 0x%02X", (unsigned char)fifo_preread(&(fifo), i+j)); \
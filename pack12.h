@@ -0,0 +1,74 @@
+#ifndef __pack12_H
+#define __pack12_H
+
+/* 12bit sample packing header-only library
+ * two 12bit values (for example, a dual ADC sample) are stored in 3 bytes, as a little endian 24bit word `a | b << 12`
+ * the packer is shared by MCU and host simulator, host unpacks them with SSSE3 if available
+ */
+
+#include "fifo.h"
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#define PACK12_PAIR_SIZE 3
+
+static inline void pack12_pack(char* dest, uint16_t a, uint16_t b) {
+    dest[0] = (char)a;
+    dest[1] = (char)(((a >> 8) & 0x0F) | (b << 4));
+    dest[2] = (char)(b >> 4);
+}
+
+// not safe when fifo_remain < 3. the pair is published at once, a consumer never sees a part of it
+static inline void pack12_enque(Fifo_t* fifo, uint16_t a, uint16_t b) {
+    char pair[PACK12_PAIR_SIZE];
+    pack12_pack(pair, a, b);
+    fifo_spsc_copy_from_buffer(fifo, pair, PACK12_PAIR_SIZE);
+}
+
+// unpack `pairs` pairs from src into dest[2*pairs]: a0, b0, a1, b1 ...
+// with SSSE3, 12 bytes are shuffled into 4 32bit lanes of `b1 b0 | b2 b1` each, a = lane & 0xFFF and b = (lane >> 4) & 0xFFF0000
+static inline void pack12_unpack(uint16_t* dest, const char* src, uint32_t pairs) {
+    uint32_t i = 0;
+#if defined(__SSSE3__)
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i mask_a = _mm_set1_epi32(0x00000FFF);
+    const __m128i mask_b = _mm_set1_epi32(0x0FFF0000);
+    for (; i + 6 <= pairs; i += 4) {  // loads 16 bytes for 12, so keep 2 pairs behind
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(const void*)(src + 3 * i)), shuffle);
+        v = _mm_or_si128(_mm_and_si128(v, mask_a), _mm_and_si128(_mm_srli_epi32(v, 4), mask_b));
+        _mm_storeu_si128((__m128i*)(void*)(dest + 2 * i), v);
+    }
+#endif
+    for (; i < pairs; ++i) {
+        const unsigned char* p = (const unsigned char*)src + 3 * i;
+        dest[2 * i] = p[0] | ((p[1] & 0x0F) << 8);
+        dest[2 * i + 1] = (p[1] >> 4) | (p[2] << 4);
+    }
+}
+
+// same as pack12_unpack, but output value * scale as float
+static inline void pack12_unpack_float(float* dest, const char* src, uint32_t pairs, float scale) {
+    uint32_t i = 0;
+#if defined(__SSSE3__)
+    const __m128i shuffle = _mm_setr_epi8(0, 1, 1, 2, 3, 4, 4, 5, 6, 7, 7, 8, 9, 10, 10, 11);
+    const __m128i mask_a = _mm_set1_epi32(0x00000FFF);
+    const __m128i mask_b = _mm_set1_epi32(0x0FFF0000);
+    const __m128 vscale = _mm_set1_ps(scale);
+    for (; i + 6 <= pairs; i += 4) {
+        __m128i v = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(const void*)(src + 3 * i)), shuffle);
+        v = _mm_or_si128(_mm_and_si128(v, mask_a), _mm_and_si128(_mm_srli_epi32(v, 4), mask_b));
+        __m128i lo = _mm_unpacklo_epi16(v, _mm_setzero_si128());
+        __m128i hi = _mm_unpackhi_epi16(v, _mm_setzero_si128());
+        _mm_storeu_ps(dest + 2 * i, _mm_mul_ps(_mm_cvtepi32_ps(lo), vscale));
+        _mm_storeu_ps(dest + 2 * i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vscale));
+    }
+#endif
+    for (; i < pairs; ++i) {
+        const unsigned char* p = (const unsigned char*)src + 3 * i;
+        dest[2 * i] = (p[0] | ((p[1] & 0x0F) << 8)) * scale;
+        dest[2 * i + 1] = ((p[1] >> 4) | (p[2] << 4)) * scale;
+    }
+}
+
+#endif
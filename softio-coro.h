@@ -0,0 +1,154 @@
+#ifndef __softio_coro_H
+#define __softio_coro_H
+
+/* C++20 coroutines of softio transactions, for host
+ * a control sequence is written as a coroutine returning SoftIO_Task_t, which `co_await`s softio operations, e.g., `co_await coro.read(mem.gpio_count)`.
+ * SoftIO_Coro_t is a single threaded scheduler: run() resumes coroutines as the replies of their transactions are handled (see softio-future.h),
+ * so that one thread drives several streams and control loops of one device, without blocking waits or polling sleeps.
+ * an awaited operation returns false if its transaction is dropped by resync. this header is optional, the rest of softio stays C++11
+ */
+
+#if !defined(__cpp_impl_coroutine) && !defined(__cpp_coroutines)
+#error "softio-coro.h requires C++20 coroutines, e.g., -std=c++20"
+#endif
+
+#include "softio-future.h"
+#include <coroutine>
+#include <exception>
+#include <chrono>
+#include <thread>
+#include <queue>
+
+// coroutine of a control sequence, started by SoftIO_Coro_t::spawn or by `co_await` it in another one
+class SoftIO_Task_t {
+public:
+	struct promise_type {
+		std::coroutine_handle<> continuation;  // the awaiting coroutine, resumed when it's done
+		SoftIO_Task_t get_return_object() { return SoftIO_Task_t(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		struct final_awaiter {
+			bool await_ready() noexcept { return false; }
+			std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+				std::coroutine_handle<> c = h.promise().continuation;
+				return c ? c : std::noop_coroutine();
+			}
+			void await_resume() noexcept {}
+		};
+		final_awaiter final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+	SoftIO_Task_t(SoftIO_Task_t&& t) noexcept: handle(t.handle) { t.handle = nullptr; }
+	SoftIO_Task_t& operator=(SoftIO_Task_t&& t) noexcept {
+		if (this != &t) {
+			if (handle) handle.destroy();
+			handle = t.handle;
+			t.handle = nullptr;
+		}
+		return *this;
+	}
+	SoftIO_Task_t(const SoftIO_Task_t&) = delete;
+	~SoftIO_Task_t() { if (handle) handle.destroy(); }
+	bool done() const { return !handle || handle.done(); }
+	// run it inside another coroutine, e.g., `co_await sub_sequence()`
+	bool await_ready() const { return done(); }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	void await_resume() {}
+private:
+	explicit SoftIO_Task_t(std::coroutine_handle<promise_type> h): handle(h) {}
+	std::coroutine_handle<promise_type> handle;
+	friend struct SoftIO_Coro_t;
+};
+
+struct SoftIO_Coro_t {
+	typedef std::chrono::steady_clock::time_point Time_t;
+	typedef std::pair<Time_t, std::coroutine_handle<>> Timer_t;
+	SoftIO_Futures_t* futures;
+	std::deque<std::coroutine_handle<>> ready;  // to be resumed by run()
+	std::priority_queue<Timer_t, std::vector<Timer_t>, std::greater<Timer_t>> timers;  // earliest first
+	std::vector<SoftIO_Task_t> tasks;  // spawned, destroyed when done
+	SoftIO_Coro_t(): futures(NULL) {}
+	void attach(SoftIO_Futures_t& _futures) { futures = &_futures; }
+
+	// awaiting a future resumes the coroutine from run(), not from the callback inside softio
+	struct Await_t {
+		SoftIO_Coro_t* coro;
+		SoftIO_Future_t future;
+		bool await_ready() const { return future.ready(); }
+		void await_suspend(std::coroutine_handle<> h) {
+			SoftIO_Coro_t* c = coro;
+			future.then([c, h](bool) { c->ready.push_back(h); });
+		}
+		bool await_resume() const { return future.done(); }
+	};
+	struct Sleep_t {
+		SoftIO_Coro_t* coro;
+		Time_t until;
+		bool await_ready() const { return false; }
+		void await_suspend(std::coroutine_handle<> h) { coro->timers.push(Timer_t(until, h)); }
+		void await_resume() const {}
+	};
+
+	// start a coroutine, it runs when run() is called
+	void spawn(SoftIO_Task_t&& task) {
+		assert(futures && "not attached");
+		ready.push_back(task.handle);
+		tasks.push_back(std::move(task));
+	}
+	// resume coroutines until all spawned ones are done
+	void run() {
+		assert(futures && "not attached");
+		while (1) {
+			while (!ready.empty()) {
+				std::coroutine_handle<> h = ready.front();
+				ready.pop_front();
+				h.resume();
+			}
+			for (size_t i = 0; i < tasks.size(); ) {
+				if (tasks[i].done()) tasks.erase(tasks.begin() + i);
+				else ++i;
+			}
+			if (tasks.empty()) break;
+			step();
+		}
+	}
+	// block until something could be resumed: a due timer, or a reply of softio
+	// a timer may be late by one round trip when transactions are in flight
+	void step() {
+		SoftIO_t* sio = futures->sio;
+		Time_t now = std::chrono::steady_clock::now();
+		if (!timers.empty() && timers.top().first <= now) {
+			while (!timers.empty() && timers.top().first <= now) {
+				ready.push_back(timers.top().second);
+				timers.pop();
+			}
+		} else if (sio->read != sio->write) __softio_wait_one(sio);
+		else if (!futures->inflight.empty()) futures->drop();
+		else if (sio->tags) {
+			__softio_settle(sio);
+			softio_flush(*sio);
+			if (sio->tags) __softio_wait_frame(sio);
+		} else if (!timers.empty()) std::this_thread::sleep_until(timers.top().first);
+		else assert(0 && "coroutines are waiting for nothing");
+	}
+
+	// awaitable operations, same as those of SoftIO_Futures_t
+	template <typename T> Await_t read(T& var) { return Await_t{this, futures->read(var)}; }
+	template <typename T1, typename T2> Await_t read_between(T1& var1, T2& var2) { return Await_t{this, futures->read_between(var1, var2)}; }
+	template <typename T> Await_t write(T& var) { return Await_t{this, futures->write(var)}; }
+	template <typename T1, typename T2> Await_t write_between(T1& var1, T2& var2) { return Await_t{this, futures->write_between(var1, var2)}; }
+	Await_t read_fifo(Fifo_t& var, uint32_t length = 254) { return Await_t{this, futures->read_fifo(var, length)}; }
+	Await_t write_fifo(Fifo_t& var, uint32_t length = 254) { return Await_t{this, futures->write_fifo(var, length)}; }
+	template <typename T> Await_t read_tagged(T& var) { return Await_t{this, futures->read_tagged(var)}; }
+	Await_t fence() { return Await_t{this, futures->fence()}; }
+	Await_t last() { return Await_t{this, futures->last()}; }  // after any softio_delay_xxx, e.g., programs
+	template <typename Rep, typename Period> Sleep_t sleep(std::chrono::duration<Rep, Period> d) {
+		return Sleep_t{this, std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(d)};
+	}
+	Sleep_t yield() { return Sleep_t{this, Time_t()}; }  // let other coroutines run
+};
+
+#endif
@@ -0,0 +1,149 @@
+#ifndef __softio_future_H
+#define __softio_future_H
+
+/* futures of softio transactions, for C++ host
+ * a future is taken for the last transaction put into the window, and completed by `callback` of softio when its reply is handled.
+ * since replies are handled in order, transactions before it are done too. futures are driven by any wait of softio, or by poll().
+ * a transaction dropped by resync (see softio.lost) completes its future as lost. not thread safe, like softio itself
+ */
+
+#ifndef SOFTIO_USE_FUNCTION
+#ifdef __softio_H
+#error "softio.h is included without SOFTIO_USE_FUNCTION"
+#endif
+#define SOFTIO_USE_FUNCTION
+#endif
+#include "softio.h"
+#include <memory>
+#include <deque>
+#include <vector>
+#include <functional>
+
+struct SoftIO_Promise_t {
+	char state;  // 0: pending, 1: done, 2: lost
+	uint32_t tag;  // SOFTIO_TAG_NONE if it's in window
+	std::vector<std::function<void(bool)>> thens;
+	SoftIO_Promise_t(uint32_t _tag): state(0), tag(_tag) {}
+	void resolve(bool done) {
+		state = done ? 1 : 2;
+		std::vector<std::function<void(bool)>> fs;
+		fs.swap(thens);
+		for (auto& f : fs) f(done);
+	}
+};
+
+struct SoftIO_Futures_t;
+class SoftIO_Future_t {
+public:
+	SoftIO_Future_t(): owner(NULL) {}  // an empty future is done
+	SoftIO_Future_t(SoftIO_Futures_t* _owner, std::shared_ptr<SoftIO_Promise_t> _promise): owner(_owner), promise(_promise) {}
+	bool ready() const { return !promise || promise->state != 0; }
+	bool done() const { return !promise || promise->state == 1; }
+	bool wait();  // block until it's ready, return false if it's lost
+	void then(std::function<void(bool)> f) {  // called with done() when it's ready, at once if it's ready already
+		if (ready()) f(done());
+		else promise->thens.push_back(f);
+	}
+private:
+	SoftIO_Futures_t* owner;
+	std::shared_ptr<SoftIO_Promise_t> promise;
+};
+
+struct SoftIO_Futures_t {
+	SoftIO_t* sio;
+	std::deque<std::shared_ptr<SoftIO_Promise_t>> inflight;  // of window transactions, in order
+	std::shared_ptr<SoftIO_Promise_t> tagged[SOFTIO_TAG_LENGTH];
+	std::function<void(void*, SoftIO_Head_t*)> chained;  // callback of softio before attach
+	SoftIO_Futures_t(): sio(NULL) {}
+
+	// hook the callback of softio, the previous one is still called after futures are completed
+	void attach(SoftIO_t& softio) {
+		sio = &softio;
+		chained = softio.callback;
+		softio.callback = [this](void* s, SoftIO_Head_t* head) {
+			replied(head);
+			if (chained) chained(s, head);
+		};
+	}
+	// future of the last transaction in window, call it right after a softio_delay_xxx which puts transactions into window
+	SoftIO_Future_t last() {
+		assert(sio && "not attached");
+		if (sio->read == sio->write) return SoftIO_Future_t();  // nothing pending, e.g., after posted writes
+		SoftIO_Trans_t* tptr = sio->transactions + (sio->write - 1 + sio->length) % sio->length;
+		if (tptr->context) {  // already taken
+			for (auto& p : inflight) if (p.get() == tptr->context) return SoftIO_Future_t(this, p);
+		}
+		std::shared_ptr<SoftIO_Promise_t> p = std::make_shared<SoftIO_Promise_t>(SOFTIO_TAG_NONE);
+		tptr->context = p.get();
+		inflight.push_back(p);
+		return SoftIO_Future_t(this, p);
+	}
+	// future of a tagged read, see softio_delay_read_tagged
+	SoftIO_Future_t tag(uint32_t id) {
+		if (id == SOFTIO_TAG_NONE) return last();
+		tagged[id] = std::make_shared<SoftIO_Promise_t>(id);
+		return SoftIO_Future_t(this, tagged[id]);
+	}
+	// send what's delayed and handle replies received, without blocking
+	void poll() {
+		softio_flush(*sio);
+		while (__softio_try_handle_one(sio) == 0);
+		if (sio->read == sio->write) drop();
+	}
+	// window is empty, so the rest are dropped by resync
+	void drop() {
+		while (!inflight.empty()) {
+			std::shared_ptr<SoftIO_Promise_t> p = inflight.front();
+			inflight.pop_front();
+			p->resolve(false);
+		}
+	}
+	// remote is gone, nothing will be replied
+	void drop_all() {
+		drop();
+		for (auto& t : tagged) {
+			std::shared_ptr<SoftIO_Promise_t> p;
+			p.swap(t);
+			if (p) p->resolve(false);
+		}
+	}
+	void replied(SoftIO_Head_t* head) {
+		if (head >= sio->tagged && head < sio->tagged + SOFTIO_TAG_LENGTH) {
+			std::shared_ptr<SoftIO_Promise_t> p;
+			p.swap(tagged[head - sio->tagged]);
+			if (p) p->resolve(true);
+			return;
+		}
+		SoftIO_Trans_t* tptr = (SoftIO_Trans_t*)(void*)head;  // head is the first
+		if (!tptr->context) return;
+		while (!inflight.empty()) {  // the ones before it are dropped by resync
+			std::shared_ptr<SoftIO_Promise_t> p = inflight.front();
+			inflight.pop_front();
+			p->resolve(p.get() == tptr->context);
+			if (p.get() == tptr->context) break;
+		}
+		tptr->context = NULL;
+	}
+
+	template <typename T> SoftIO_Future_t read(T& var) { softio_delay_read(*sio, var); return last(); }
+	template <typename T1, typename T2> SoftIO_Future_t read_between(T1& var1, T2& var2) { softio_delay_read_between(*sio, var1, var2); return last(); }
+	template <typename T> SoftIO_Future_t write(T& var) { softio_delay_write(*sio, var); return last(); }
+	template <typename T1, typename T2> SoftIO_Future_t write_between(T1& var1, T2& var2) { softio_delay_write_between(*sio, var1, var2); return last(); }
+	SoftIO_Future_t read_fifo(Fifo_t& var, uint32_t length = 254) { softio_delay_read_fifo_part(*sio, var, length); return last(); }
+	SoftIO_Future_t write_fifo(Fifo_t& var, uint32_t length = 254) { softio_delay_write_fifo_part(*sio, var, length); return last(); }
+	template <typename T> SoftIO_Future_t read_tagged(T& var) { return tag(softio_delay_read_tagged(*sio, var)); }
+	SoftIO_Future_t fence() { softio_delay_fence(*sio); return last(); }  // done when all writes before, including posted ones, are done
+};
+
+inline bool SoftIO_Future_t::wait() {
+	if (!promise) return true;
+	SoftIO_t* sio = owner->sio;
+	while (promise->state == 0) {
+		if (promise->tag != SOFTIO_TAG_NONE) __softio_wait_tags(sio, 1u << promise->tag);
+		else if (sio->read == sio->write) owner->drop();
+		else __softio_wait_one(sio);
+	}
+	return promise->state == 1;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef __softio_mirror_H
+#define __softio_mirror_H
+
+/* mirror mapped buffer of a fifo, for Linux host
+ * a memfd is mapped twice back to back, so the bytes after the end are the ones at the beginning. a fifo on it (see fifo_init_mirror) is
+ * contiguous from any position: gets of port fills all free space in a single call, and frames are summed and copied without a split at
+ * wrap around. map() returns false where it's not supported, and the fifo keeps its own buffer
+ */
+
+#include "fifo.h"
+#include "assert.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+struct SoftIO_Mirror_t {
+	char* base;  // of the first mapping, NULL if not mapped
+	uint32_t length;
+	SoftIO_Mirror_t(): base(NULL), length(0) {}
+	~SoftIO_Mirror_t() { unmap(); }
+	SoftIO_Mirror_t(const SoftIO_Mirror_t&) = delete;
+	SoftIO_Mirror_t& operator=(const SoftIO_Mirror_t&) = delete;
+
+#ifdef __linux__
+	// map length bytes twice and init fifo on them. length is a power of 2 and a multiple of page size
+	bool map(Fifo_t* fifo, uint32_t _length) {
+		assert(!base && "already mapped");
+		assert(_length && !(_length & (_length - 1)) && _length % sysconf(_SC_PAGESIZE) == 0 && "length must be power of 2 and multiple of page size");
+		int fd = memfd_create("softio-mirror", MFD_CLOEXEC);
+		if (fd < 0) return false;
+		char* area = NULL;
+		if (ftruncate(fd, _length) == 0) area = reserve(fifo, 2 * (size_t)_length);
+		bool ok = area
+			&& mmap(area, _length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == area
+			&& mmap(area + _length, _length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == area + _length;
+		::close(fd);  // mappings keep the memory
+		if (!ok) {
+			if (area) munmap(area, 2 * (size_t)_length);
+			return false;
+		}
+		base = area;
+		length = _length;
+		fifo_init_mirror(fifo, base, length);
+		return true;
+	}
+	// the fifo must not be used after it, unless initialized again
+	void unmap() {
+		if (!base) return;
+		munmap(base, 2 * (size_t)length);
+		base = NULL;
+		length = 0;
+	}
+	// address space of size bytes within reach of fifo (see fifo_in_reach), asked below it first where the program image leaves room
+	static char* reserve(Fifo_t* fifo, size_t size) {
+		const intptr_t step = (intptr_t)1 << 26;
+		for (int i = 1; i < 32; ++i) {
+			intptr_t hint = ((intptr_t)fifo & ~(step - 1)) + (i < 16 ? -i : i - 15) * step;
+			if (hint <= 0) continue;
+			void* area = mmap((void*)hint, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (area == MAP_FAILED) continue;
+			if (fifo_in_reach(fifo, (char*)area)) return (char*)area;
+			munmap(area, size);  // the hint is taken
+		}
+		return NULL;
+	}
+#else
+	bool map(Fifo_t*, uint32_t) { return false; }
+	void unmap() {}
+#endif
+};
+
+#endif
@@ -0,0 +1,147 @@
+#ifndef __softio_reactor_H
+#define __softio_reactor_H
+
+/* one event loop of many devices, for Linux host
+ * with gets and puts each device needs a thread blocked in its port. here an epoll loop owns the file descriptors of all of them:
+ * received bytes go into rx of softio, frames are handled by softio_progress which completes futures (see softio-future.h), and tx is
+ * written out as far as the port takes it. a device issues new transactions from its poll function, when softio_can_issue says that
+ * softio_delay_xxx would not block. gets and puts of softio are not used, so nothing waits except epoll_wait
+ */
+
+#include "softio-future.h"
+#include "assert.h"
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+struct SoftIO_Reactor_t {
+	typedef std::chrono::steady_clock::time_point Time_t;
+	struct Device_t {
+		int fd;
+		SoftIO_t* sio;
+		SoftIO_Futures_t* futures;
+		std::function<void()> poll;  // called after frames are handled, issue new transactions here
+		bool writing;  // EPOLLOUT is registered, since tx is not empty
+		Time_t active;  // last time a byte is received or nothing is in flight
+		bool failed;  // the port is gone (read returns 0 or an error, or write an error), it's no longer polled and its futures are lost. remove it then
+	};
+	int epfd;
+	std::vector<Device_t*> devices;
+	std::chrono::milliseconds timeout;  // resync a device after it with transactions in flight, like the timeout of gets. see SOFTIO_RESYNC_TIMEOUT
+	SoftIO_Reactor_t(): epfd(epoll_create1(EPOLL_CLOEXEC)), timeout(1000) {
+		assert(epfd >= 0 && "epoll_create1 failed");
+	}
+	~SoftIO_Reactor_t() {
+		while (!devices.empty()) remove(devices.back());
+		::close(epfd);
+	}
+	SoftIO_Reactor_t(const SoftIO_Reactor_t&) = delete;
+	SoftIO_Reactor_t& operator=(const SoftIO_Reactor_t&) = delete;
+
+	// take fd (set to non-blocking) of a device, whose softio is attached to futures. fd is not closed by reactor
+	Device_t* add(int fd, SoftIO_Futures_t& futures, std::function<void()> poll = nullptr) {
+		assert(futures.sio && "futures not attached");
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		Device_t* dev = new Device_t{fd, futures.sio, &futures, poll, false, std::chrono::steady_clock::now(), false};
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.ptr = dev;
+		int ret = epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+		assert(ret == 0 && "epoll_ctl failed");
+		(void)ret;
+		devices.push_back(dev);
+		return dev;
+	}
+	void remove(Device_t* dev) {
+		if (!dev->failed) epoll_ctl(epfd, EPOLL_CTL_DEL, dev->fd, NULL);
+		for (size_t i = 0; i < devices.size(); ++i) if (devices[i] == dev) devices.erase(devices.begin() + i);
+		delete dev;
+	}
+
+	// wait at most ms for events, then move bytes and handle frames of devices. poll of every device is called once
+	void run_once(int ms) {
+		struct epoll_event events[64];
+		for (Device_t* dev : devices) if (!waiting(dev->sio)) dev->active = std::chrono::steady_clock::now();
+		int n = epoll_wait(epfd, events, 64, ms);
+		for (int i = 0; i < n; ++i) {
+			Device_t* dev = (Device_t*)events[i].data.ptr;
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) receive(dev);
+		}
+		Time_t now = std::chrono::steady_clock::now();
+		for (Device_t* dev : devices) {
+			if (dev->failed) continue;
+			SoftIO_t* sio = dev->sio;
+			softio_progress(*sio);
+			if (sio->read == sio->write && !sio->tags) dev->futures->drop();  // nothing in flight, the rest are dropped by resync
+			if (dev->poll) dev->poll();
+			auto limit = sio->resync ? std::chrono::milliseconds(SOFTIO_RESYNC_TIMEOUT) : timeout;  // a lost marker of resync is found sooner
+			if (now - dev->active > limit && (sio->features & SOFTIO_FEATURE_RESYNC) && fifo_remain(sio->tx) >= 6) {
+				sio->error = "timeout";  // a frame, a credit report or SOFTIO_EXT_SYNC is lost, resync (again) like gets does
+				++sio->errors;
+				__softio_sync(sio);
+				dev->active = now;
+			}
+			send(dev);
+		}
+	}
+	// run until done() returns true, which is checked after every round
+	template <typename P> void run_until(P done, int ms = 10) {
+		while (!done()) run_once(ms);
+	}
+
+	// expects bytes from remote, same conditions as the timeout of gets
+	static bool waiting(SoftIO_t* sio) {
+		return sio->read != sio->write || sio->tags || sio->resync || (sio->credit_capacity && sio->credit_sent != sio->credit_acked);
+	}
+	void receive(Device_t* dev) {
+		Fifo_t* rx = dev->sio->rx;
+		while (1) {
+			Fifo_Spans_t spans;
+			if (!fifo_write_spans(rx, &spans, fifo_remain(rx))) {
+				softio_progress(*dev->sio);  // frames make room
+				if (!fifo_write_spans(rx, &spans, fifo_remain(rx))) break;
+			}
+			ssize_t n = ::read(dev->fd, spans.ptr[0], spans.len[0]);
+			if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) break;
+			if (n <= 0) {  // the port is gone, which would be reported by epoll forever
+				fail(dev);
+				break;
+			}
+			fifo_write_commit(rx, n);
+			dev->active = std::chrono::steady_clock::now();
+		}
+	}
+	void fail(Device_t* dev) {
+		epoll_ctl(epfd, EPOLL_CTL_DEL, dev->fd, NULL);
+		dev->failed = true;
+		dev->futures->drop_all();
+	}
+	void send(Device_t* dev) {
+		Fifo_t* tx = dev->sio->tx;
+		while (!fifo_empty(tx)) {
+			Fifo_Spans_t spans;
+			fifo_read_spans(tx, &spans, fifo_count(tx));
+			ssize_t n = ::write(dev->fd, spans.ptr[0], spans.len[0]);
+			if (n == 0 || (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))) break;  // port is full, wait for EPOLLOUT
+			if (n < 0) {  // the port is gone, EPOLLOUT would never come
+				fail(dev);
+				return;
+			}
+			fifo_read_commit(tx, n);
+		}
+		bool writing = !fifo_empty(tx);
+		if (writing != dev->writing) {
+			struct epoll_event ev;
+			ev.events = writing ? EPOLLIN | EPOLLOUT : EPOLLIN;
+			ev.data.ptr = dev;
+			epoll_ctl(epfd, EPOLL_CTL_MOD, dev->fd, &ev);
+			dev->writing = writing;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef __softio_thread_H
+#define __softio_thread_H
+
+/* background threads moving bytes between the port and softio, for C++ host
+ * without it, bytes are only pulled from the port while softio waits (gets in softio_flush or a blocking call), so the port buffer fills up
+ * when the application is busy and the link stalls. here a reader thread reads the port all the time straight into the free space of a
+ * power of 2 fifo, and a writer thread sends what softio puts into another one straight from its data (fifo spans). both are shared by
+ * fifo_spsc_xxx, so data is never behind a mutex: the mutex and condition variable are only for sleeping when a ring is empty or full
+ */
+
+#ifndef SOFTIO_USE_FUNCTION
+#ifdef __softio_H
+#error "softio.h is included without SOFTIO_USE_FUNCTION"
+#endif
+#define SOFTIO_USE_FUNCTION
+#endif
+#include "softio.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+
+// bytes of each ring, a power of 2
+#ifndef SOFTIO_THREAD_RING_LENGTH
+#define SOFTIO_THREAD_RING_LENGTH (1 << 16)
+#endif
+
+// sleep until a condition holds, woken by the other thread. notify() costs nothing if nobody sleeps
+struct SoftIO_Event_t {
+	std::atomic<int> waiters;
+	std::mutex mutex;
+	std::condition_variable cv;
+	SoftIO_Event_t(): waiters(0) {}
+	template <typename P> bool wait(P ready, std::chrono::milliseconds timeout) {
+		if (ready()) return true;
+		std::unique_lock<std::mutex> lock(mutex);
+		waiters.fetch_add(1);
+		std::atomic_thread_fence(std::memory_order_seq_cst);  // pairs with the one in notify, so either we see the data or it sees us
+		bool ret = cv.wait_for(lock, timeout, ready);
+		waiters.fetch_sub(1);
+		return ret;
+	}
+	void notify() {
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (waiters.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(mutex);
+			cv.notify_all();
+		}
+	}
+};
+
+struct SoftIO_Threaded_t {
+	char rx_buf[SOFTIO_THREAD_RING_LENGTH];  // next to the fifos, so that they're in reach (see fifo_in_reach)
+	char tx_buf[SOFTIO_THREAD_RING_LENGTH];
+	Fifo_t rx;  // port => softio, reader thread is the producer
+	Fifo_t tx;  // softio => port, writer thread is the consumer
+	SoftIO_Event_t rx_data, rx_space, tx_data, tx_space;
+	std::chrono::milliseconds timeout;  // of gets, like the timeout of port, softio resyncs after it
+	std::function<size_t(char*, size_t)> read;  // of port, may block for its timeout
+	std::function<size_t(char*, size_t)> write;
+	std::function<size_t()> available;
+	std::atomic<bool> running;
+	std::thread reader, writer;
+	SoftIO_Threaded_t(): timeout(1000), running(false) {
+		FIFO_POW2_STD_INIT((*this), rx);
+		FIFO_POW2_STD_INIT((*this), tx);
+	}
+	~SoftIO_Threaded_t() { stop(); }
+
+	// set gets, puts and available of softio to use the rings
+	void attach(SoftIO_t& softio) {
+		softio.gets = [this, &softio](char* buffer, size_t size) { return gets(buffer, size, softio.resync != 0); };
+		softio.puts = [this](char* buffer, size_t size) { return puts(buffer, size); };
+		softio.available = [this]() { return (size_t)fifo_spsc_count(&rx); };
+	}
+	// start threads with the functions of port
+	void start(std::function<size_t(char*, size_t)> _read, std::function<size_t(char*, size_t)> _write, std::function<size_t()> _available) {
+		assert(!running && "already started");
+		read = _read;
+		write = _write;
+		available = _available;
+		running = true;
+		reader = std::thread([this]() { read_loop(); });
+		writer = std::thread([this]() { write_loop(); });
+	}
+	// wait until tx is sent, then stop threads. the reader may take the timeout of port to return
+	void stop() {
+		if (!running) return;
+		tx_space.wait([this]() { return fifo_spsc_count(&tx) == 0; }, timeout);
+		running = false;
+		rx_space.notify();
+		tx_data.notify();
+		reader.join();
+		writer.join();
+	}
+
+	// block until some bytes are received, return 0 after timeout, which is SOFTIO_RESYNC_TIMEOUT while a resync is pending
+	size_t gets(char* buffer, size_t size, bool resync = false) {
+		rx_data.wait([this]() { return !fifo_spsc_empty(&rx); }, resync ? std::chrono::milliseconds(SOFTIO_RESYNC_TIMEOUT) : timeout);
+		size_t ret = fifo_spsc_move_to_buffer(buffer, &rx, size);
+		if (ret) rx_space.notify();
+		return ret;
+	}
+	// block until all bytes are put into tx ring
+	size_t puts(char* buffer, size_t size) {
+		size_t ret = 0;
+		while (ret < size) {
+			size_t n = fifo_spsc_copy_from_buffer(&tx, buffer + ret, size - ret);
+			if (n) tx_data.notify();
+			else tx_space.wait([this]() { return fifo_spsc_remain(&tx) != 0; }, timeout);
+			ret += n;
+		}
+		return ret;
+	}
+
+	// port is read straight into free space of rx, a wrap around is read in the next round
+	void read_loop() {
+		while (running) {
+			if (!rx_space.wait([this]() { return fifo_spsc_remain(&rx) != 0 || !running; }, timeout)) continue;
+			size_t n = available();
+			if (n == 0) n = 1;  // block for the first byte
+			Fifo_Spans_t spans;
+			if (!fifo_write_spans(&rx, &spans, n)) continue;  // only when stopping
+			n = read(spans.ptr[0], spans.len[0]);
+			if (n) {
+				fifo_write_commit(&rx, n);
+				rx_data.notify();
+			}
+		}
+	}
+	// port is written straight from data of tx. a port which takes nothing (closed, or timed out) is retried a while later
+	void write_loop() {
+		while (running) {
+			if (!tx_data.wait([this]() { return !fifo_spsc_empty(&tx) || !running; }, timeout)) continue;
+			Fifo_Spans_t spans;
+			if (!fifo_read_spans(&tx, &spans, fifo_capacity(&tx))) continue;  // only when stopping
+			size_t n = write(spans.ptr[0], spans.len[0]);
+			if (n) {
+				fifo_read_commit(&tx, n);
+				tx_space.notify();
+			} else std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+};
+
+#endif
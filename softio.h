@@ -11,6 +11,11 @@
 
 #include "fifo.h"
 #include "assert.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #ifdef SOFTIO_USE_FUNCTION  // for c++ lambda support
 #include <functional>
 #endif
@@ -44,6 +49,7 @@ typedef struct {
 #define SOFTIO_HEAD_TYPE_CLEAR_FIFO 0x8
 #define SOFTIO_HEAD_TYPE_RESET_FIFO 0xA
 #define SOFTIO_HEAD_TYPE_MCU_RESET 0xC
+#define SOFTIO_HEAD_TYPE_EXTEND 0xE  // extended request, the length field is used as opcode, see SOFTIO_EXT_xxx below
 #define SOFTIO_HEAD_TYPE_IS_REQUEST(type) (!((type)&0x01))
 #define SOFTIO_HEAD_TYPE_IS_RET(type) (!!((type)&0x01))
 #define SOFTIO_HEAD_TYPE_RAW(type) ((type)&0x0E)
@@ -55,42 +61,345 @@ typedef struct {
 	SOFTIO_HEAD_TYPE_RAW(type) == SOFTIO_HEAD_TYPE_CLEAR_FIFO ? "clearfifo" : (\
 	SOFTIO_HEAD_TYPE_RAW(type) == SOFTIO_HEAD_TYPE_RESET_FIFO ? "resetfifo" : (\
 	SOFTIO_HEAD_TYPE_RAW(type) == SOFTIO_HEAD_TYPE_MCU_RESET ? "mcu_reset" : (\
-"unknown" ))))))))
+	SOFTIO_HEAD_TYPE_RAW(type) == SOFTIO_HEAD_TYPE_EXTEND ? "extend" : (\
+"unknown" )))))))))
 #define SOFTIO_HEAD_TYPE_REQRET_STR(type) (SOFTIO_HEAD_TYPE_IS_REQUEST(type) ? "request" : "ret")
 	uint32_t type   : 4;
 	uint32_t addr   : 20;
 	uint32_t length : 8;
 } SoftIO_Head_t;
 
+// extended request: 4 byte head with type=0xE and length=opcode, followed by 16bit little endian length (xlength)
+//   the reply starts with 0xF, opcode, 16bit xlength, followed by data and checksum just like legacy ones
+#define SOFTIO_EXT_READ 0x00  // return `0xF + 0x00 + 16bit length + data + 8bit checksum`
+#define SOFTIO_EXT_WRITE 0x01  // with data and checksum followed, return `0xF + 0x01 + 16bit length`
+#define SOFTIO_EXT_READ_MULTI 0x02  // 16bit xlength is region count, followed by read heads (as regions) and checksum,
+                                    //   return `0xF + 0x02 + 16bit total length + data of all regions + 8bit checksum`
+#define SOFTIO_EXT_WRITE_POSTED 0x03  // same as 0x01 but slave never returns anything, so that it doesn't hold a transaction slot
+#define SOFTIO_EXT_FENCE 0x04  // xlength=0, return `0xF + 0x04 + 16bit 0` after all requests before it are done (including posted writes)
+#define SOFTIO_EXT_CREDIT 0x05  // xlength=0, enable credit flow control, return `0xF + 0x05 + 16bit 0 + 16bit rx capacity`
+#define SOFTIO_EXT_SUBSCRIBE 0x06  // xlength is length (0 to unsubscribe), followed by 8bit id + 8bit flags + 16bit period + 8bit checksum,
+                                   //   return `0xF + 0x06 + 16bit length`. see SoftIO_Sub_t
+#define SOFTIO_EXT_RUN 0x07  // head.addr is a stored program in shared memory and xlength is its length, see SOFTIO_PROG_WAIT below.
+                             //   return `0xF + 0x07 + 16bit length + 8bit executed count + data of reads + 8bit checksum`
+#define SOFTIO_EXT_ATOMIC 0x08  // xlength is width (1, 2 or 4) of an aligned word, followed by 8bit operation + 32bit a + 32bit b + 8bit checksum,
+                                //   return `0xF + 0x08 + 16bit width + old value + new value + 8bit checksum`. see SOFTIO_ATOMIC_xxx
+#define SOFTIO_EXT_SYNC 0x09  // head.addr is SOFTIO_SYNC_MAGIC and xlength is an id, return `0xF + 0x09 + 16bit id + 16bit handled + 8bit checksum`
+                              //   where handled is the count of requests handled before (wraps). it's the marker of resync, see __softio_error
+#define SOFTIO_SYNC_MAGIC 0xA55A5
+#define SOFTIO_EXT_READ_TAGGED 0x0A  // xlength is length (at most 254) followed by 8bit tag, slave may defer it and reply out of order:
+                                     //   return `0xF + 0x0A + 16bit length + 8bit tag + data + 8bit checksum` (of tag and data). see SOFTIO_TAG_LENGTH
+// opcodes with the highest bit set are pushed by slave without request, host handles them without transaction
+#define SOFTIO_EXT_IS_PUSH(op) (!!((op)&0x80))
+#define SOFTIO_EXT_CREDIT_REPORT 0x80  // `0xF + 0x80 + 16bit consumed`, bytes slave has consumed from rx since SOFTIO_EXT_CREDIT (wraps)
+#define SOFTIO_EXT_PUSH 0x81  // `0xF + 0x81 + 16bit length + 8bit id + data + 8bit checksum`, data of a subscription
+#define SOFTIO_EXT_ERROR_REPORT 0x82  // `0xF + 0x82 + 16bit errors`, slave found a corrupt request and discards rx until SOFTIO_EXT_SYNC
+#define SOFTIO_EXT_STR(op) (\
+	(op) == SOFTIO_EXT_READ ? "read" : (\
+	(op) == SOFTIO_EXT_WRITE ? "write" : (\
+	(op) == SOFTIO_EXT_READ_MULTI ? "read_multi" : (\
+	(op) == SOFTIO_EXT_WRITE_POSTED ? "write_posted" : (\
+	(op) == SOFTIO_EXT_FENCE ? "fence" : (\
+	(op) == SOFTIO_EXT_CREDIT ? "credit" : (\
+	(op) == SOFTIO_EXT_SUBSCRIBE ? "subscribe" : (\
+	(op) == SOFTIO_EXT_RUN ? "run" : (\
+	(op) == SOFTIO_EXT_ATOMIC ? "atomic" : (\
+	(op) == SOFTIO_EXT_SYNC ? "sync" : (\
+	(op) == SOFTIO_EXT_READ_TAGGED ? "read_tagged" : (\
+	(op) == SOFTIO_EXT_CREDIT_REPORT ? "credit_report" : (\
+	(op) == SOFTIO_EXT_PUSH ? "push" : (\
+	(op) == SOFTIO_EXT_ERROR_REPORT ? "error_report" : (\
+"unknown" )))))))))))))))
+
+// features supported by this library. slave should advertise it to host (for example, a word in shared memory) so that host
+//   could set `softio.features` at handshake. host with `softio.features == 0` behaves like legacy ones.
+#define SOFTIO_FEATURE_EXTEND 0x00000001  // extended-length read and write
+#define SOFTIO_FEATURE_POSTED 0x00000002  // posted write and fence
+#define SOFTIO_FEATURE_CREDIT 0x00000004  // credit flow control, slave reports consumed bytes of rx
+#define SOFTIO_FEATURE_PUSH 0x00000008  // subscriptions pushed by slave
+#define SOFTIO_FEATURE_PROGRAM 0x00000010  // stored programs run by slave
+#define SOFTIO_FEATURE_ATOMIC 0x00000020  // atomic read-modify-write of a word
+#define SOFTIO_FEATURE_RESYNC 0x00000040  // corrupt frames are discarded and both sides resync, instead of asserting
+#define SOFTIO_FEATURE_TAGGED 0x00000080  // tagged reads, completed out of order
+#ifndef SOFTIO_FEATURES
+#define SOFTIO_FEATURES (SOFTIO_FEATURE_EXTEND | SOFTIO_FEATURE_POSTED | SOFTIO_FEATURE_CREDIT | SOFTIO_FEATURE_PUSH | SOFTIO_FEATURE_PROGRAM | \
+	SOFTIO_FEATURE_ATOMIC | SOFTIO_FEATURE_RESYNC | SOFTIO_FEATURE_TAGGED)
+#endif
+
+// atomic operations, the new value is truncated to the width of word
+#define SOFTIO_ATOMIC_ADD 0x00  // old + a
+#define SOFTIO_ATOMIC_CAS 0x01  // b if old == a, otherwise old
+#define SOFTIO_ATOMIC_SET 0x02  // old | a
+#define SOFTIO_ATOMIC_CLEAR 0x03  // old & ~a
+#define SOFTIO_ATOMIC_MASKED 0x04  // (old & ~a) | (b & a)
+static inline uint32_t __softio_atomic_apply(uint32_t op, uint32_t old, uint32_t a, uint32_t b, uint32_t width) {
+	uint32_t value;
+	switch (op) {
+	case SOFTIO_ATOMIC_ADD: value = old + a; break;
+	case SOFTIO_ATOMIC_CAS: value = old == a ? b : old; break;
+	case SOFTIO_ATOMIC_SET: value = old | a; break;
+	case SOFTIO_ATOMIC_CLEAR: value = old & ~a; break;
+	case SOFTIO_ATOMIC_MASKED: value = (old & ~a) | (b & a); break;
+	default: assert(0 && "invalid atomic operation"); value = old;
+	}
+	return width == 4 ? value : value & ((1u << (8 * width)) - 1);
+}
+
+// stored programs: legacy request heads one by one in shared memory, so that a sequence of requests costs a single exchange.
+//   READ appends its data to the reply, READ_FIFO appends 8bit actual length and data, CLEAR_FIFO and RESET_FIFO work as requests.
+//   WRITE is followed by its data inline (without checksum). before/after are called with every head, as if host has sent it.
+//   SOFTIO_PROG_WAIT (type of extended request, which cannot be in a program) has addr of a 1, 2 or 4 byte variable as length,
+//   followed by 32bit mask, 32bit value and 16bit timeout in ticks: slave waits until `(var & mask) == value` or stops the
+//   program at timeout. rx is not handled while waiting, so the timeout is capped at SOFTIO_PROG_WAIT_MAX. at most 255
+//   instructions, since executed count is 8bit
+#define SOFTIO_PROG_WAIT 0xE
+static inline uint32_t __softio_prog_step(const char* inst) {  // size of the instruction
+	SoftIO_Head_t head;
+	memcpy(&head, inst, sizeof(head));
+	if (head.type == SOFTIO_HEAD_TYPE_WRITE) return 4 + head.length;
+	if (head.type == SOFTIO_PROG_WAIT) return 4 + 10;
+	return 4;
+}
+
+// heads are copied as a whole (a single 32bit load/store if not wrapped), little endian
 static inline void __softio_head_enque(Fifo_t* tx, SoftIO_Head_t* head) {
 	assert((size_t)fifo_remain(tx) >= sizeof(SoftIO_Head_t) && "cannot push head inside fifo");
-	char* buf = (char*)(void*)head;
-	for (size_t i=0; i < sizeof(SoftIO_Head_t); ++i) fifo_enque(tx, buf[i]);  // little endian
+	fifo_copy_from_buffer(tx, (const char*)(void*)head, sizeof(SoftIO_Head_t));
 }
 
 static inline void __softio_head_preread(Fifo_t* rx, SoftIO_Head_t* head) {
 	assert((size_t)fifo_count(rx) >= sizeof(SoftIO_Head_t) && "is not a head");
-	char* buf = (char*)(void*)head;
-	for (size_t i=0; i < sizeof(SoftIO_Head_t); ++i) buf[i] = fifo_preread(rx, i);
+	fifo_peek_to_buffer((char*)(void*)head, rx, 0, sizeof(SoftIO_Head_t));
+}
+static inline void __softio_head_preread_at(Fifo_t* rx, uint32_t index, SoftIO_Head_t* head) {
+	fifo_peek_to_buffer((char*)(void*)head, rx, index, sizeof(SoftIO_Head_t));
 }
 static inline void __softio_head_deque(Fifo_t* rx, SoftIO_Head_t* head) {
 	assert((size_t)fifo_count(rx) >= sizeof(SoftIO_Head_t) && "is not a head");
-	char* buf = (char*)(void*)head;
-	for (size_t i=0; i < sizeof(SoftIO_Head_t); ++i) buf[i] = fifo_deque(rx);
+	fifo_move_to_buffer((char*)(void*)head, rx, sizeof(SoftIO_Head_t));
+}
+
+// 8bit additive checksum of a buffer. on host, psadbw sums 16 (SSE2) or 32 (AVX2) bytes at a time.
+//   then word-at-a-time: bytes are accumulated in two 16bit lanes, each word adds at most 0x1FE into a lane so lanes are folded every 128 words
+static inline char __softio_sum(const char* buf, uint32_t length) {
+	uint32_t sum = 0;
+#if defined(__AVX2__)
+	if (length >= 32) {
+		__m256i acc = _mm256_setzero_si256();
+		for (; length >= 32; buf += 32, length -= 32) acc = _mm256_add_epi64(acc, _mm256_sad_epu8(_mm256_loadu_si256((const __m256i*)(const void*)buf), _mm256_setzero_si256()));
+		__m128i acc128 = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+		sum += (uint32_t)_mm_cvtsi128_si32(acc128) + (uint32_t)_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc128, acc128));
+	}
+#endif
+#if defined(__SSE2__)
+	if (length >= 16) {
+		__m128i acc = _mm_setzero_si128();
+		for (; length >= 16; buf += 16, length -= 16) acc = _mm_add_epi64(acc, _mm_sad_epu8(_mm_loadu_si128((const __m128i*)(const void*)buf), _mm_setzero_si128()));
+		sum += (uint32_t)_mm_cvtsi128_si32(acc) + (uint32_t)_mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+	}
+#endif
+	while (length >= 4) {
+		uint32_t acc = 0;
+		uint32_t words = length / 4 > 128 ? 128 : length / 4;
+		for (uint32_t i=0; i<words; ++i) {
+			uint32_t w; memcpy(&w, buf, 4); buf += 4;  // unaligned load is fine on both Cortex-M3 and x86
+			acc += (w & 0x00FF00FF) + ((w >> 8) & 0x00FF00FF);
+		}
+		sum += (acc & 0xFFFF) + (acc >> 16);
+		length -= words * 4;
+	}
+	while (length--) sum += (unsigned char)*buf++;
+	return (char)sum;
+}
+// checksum of data at (read+index)%length inside fifo, at most two spans
+static inline char __softio_fifo_sum(Fifo_t* fifo, uint32_t index, uint32_t length) {
+	uint32_t start = __fifo_pos(fifo, __fifo_next(fifo, fifo->read, index));
+	uint32_t len = __fifo_contiguous(fifo, start);
+	if (len >= length) return __softio_sum(__FIFO_GET_BASE(fifo) + start, length);
+	return __softio_sum(__FIFO_GET_BASE(fifo) + start, len) + __softio_sum(__FIFO_GET_BASE(fifo), length - len);
+}
+// move length bytes from src to dest and return the checksum of them, not safe when src count or dest remain < length
+static inline char __softio_fifo_move_sum(Fifo_t* dest, Fifo_t* src, uint32_t length) {
+	Fifo_Spans_t from, to;
+	fifo_read_spans(src, &from, length);
+	fifo_write_spans(dest, &to, length);
+	char sum = __softio_sum(from.ptr[0], from.len[0]) + __softio_sum(from.ptr[1], from.len[1]);
+	fifo_spans_copy(&to, &from, length);
+	fifo_write_commit(dest, length);  // either may be shared with an ISR or a thread
+	fifo_read_commit(src, length);
+	return sum;
+}
+// enque a reply of buffer with checksum
+static inline void __softio_enque_sum(Fifo_t* tx, const char* buf, uint32_t length) {
+	fifo_copy_from_buffer(tx, buf, length);
+	fifo_enque(tx, -__softio_sum(buf, length));
+}
+
+// FNV-1a, to find out whether subscribed data is changed
+static inline uint32_t __softio_hash(const char* buf, uint32_t length) {
+	uint32_t hash = 2166136261u;
+	while (length--) { hash ^= (unsigned char)*buf++; hash *= 16777619u; }
+	return hash;
 }
 
 // you can define the maximum pending transactions here. You should be careful to match the initiater call and defination must match the length.
-// by the way, the default 32 is enough in most cases
+// by the way, the default 32 is enough in most cases, and host could use a larger window at runtime by softio_set_window
 #ifndef SOFTIO_HEAD_LENGTH
 #define SOFTIO_HEAD_LENGTH 32
 #endif
 
+// unchanged bytes between two dirty ranges are written as well if they're no more than this, rather than starting a new frame
+#ifndef SOFTIO_DIRTY_GAP
+#define SOFTIO_DIRTY_GAP 8
+#endif
+
+// regions of pending multi read are stored in a ring, they're consumed in the same order as transactions
+#ifndef SOFTIO_REGION_LENGTH
+#define SOFTIO_REGION_LENGTH 64
+#endif
+
+// a partial frame in rx which doesn't grow for this many ticks is taken as corrupt (e.g., a wrong length), only checked with tick
+#ifndef SOFTIO_STALL_TIMEOUT
+#define SOFTIO_STALL_TIMEOUT 20
+#endif
+// host: a lost frame is only found by the timeout of gets (or of the reactor), which is long enough for a slow request. while a resync
+//   is pending, its marker could be lost too, so transports wait this many ms instead
+#ifndef SOFTIO_RESYNC_TIMEOUT
+#define SOFTIO_RESYNC_TIMEOUT 50
+#endif
+// (slave) SOFTIO_PROG_WAIT busy-waits in the handler, so a single wait never takes longer than this many ticks, well below the
+//   timeouts above. for a longer wait, host runs the program again after it stops at timeout
+#ifndef SOFTIO_PROG_WAIT_MAX
+#define SOFTIO_PROG_WAIT_MAX (SOFTIO_RESYNC_TIMEOUT / 5)
+#endif
+#define SOFTIO_RESYNC_REQUEST 1  // (slave) discarding rx until a SOFTIO_EXT_SYNC request
+#define SOFTIO_RESYNC_REPLY 2  // (host) discarding rx until the reply of SOFTIO_EXT_SYNC with sync_id
+
+// tagged reads are not in the window: slave defers one until `ready` says the region could be read without blocking, then replies
+//   with its tag. so a slow peripheral doesn't hold replies of requests behind it, and host matches the reply by tag
+#ifndef SOFTIO_TAG_LENGTH
+#define SOFTIO_TAG_LENGTH 8
+#endif
+#if SOFTIO_TAG_LENGTH > 32
+#error "tags are a 32bit mask"
+#endif
+#define SOFTIO_TAG_NONE 0xFF  // the read is in the window instead, since remote doesn't support tags
+
+typedef struct {
+	SoftIO_Head_t head;  // must be the first, callback will receive pointer to it
+	uint16_t xlength;  // length of extended transaction, since head.length is opcode
+	uint16_t xcount;  // region count of multi read
+	uint32_t* result;  // where the old value of atomic operation goes, NULL to discard
+	uint16_t seq;  // requests sent before it (wraps), to find out whether remote has handled it when resync
+	void* context;  // (host) user data, e.g., the future of softio-future.h. NULL when sent, and kept by resync
+} SoftIO_Trans_t;
+
+typedef struct {
+	void* addr;
+	uint32_t length;
+} SoftIO_Region_t;
+
+// subscriptions: slave pushes a region of memory every `period` ticks (see `tick` below), or only when it's changed if SOFTIO_SUB_ON_CHANGE.
+//   host registers them by id and gets them into local memory, then the callback of that id is called
+#ifndef SOFTIO_SUB_LENGTH
+#define SOFTIO_SUB_LENGTH 8
+#endif
+#define SOFTIO_SUB_ON_CHANGE 0x01  // check every period, push if data is changed since last push
+#define SOFTIO_SUB_FIFO 0x02  // addr is a Fifo_t, slave drains it by pushes of at most length (<255) bytes, a partial one at most every period.
+                              //   host appends them into local fifo
+#define SOFTIO_SUB_PUSHED 0x80  // (slave) pushed at least once, internal
+// hooks of an address range [begin, end) relative to base, called for requests (or instructions of programs) which include the whole range.
+//   for fifo requests the range of Fifo_t is used. types is a mask of head types to be called with, see SOFTIO_HOOK_ON_xxx
+#define SOFTIO_HOOK_ON_TYPE(type) (1u << ((type) >> 1))
+#define SOFTIO_HOOK_ON_READ SOFTIO_HOOK_ON_TYPE(SOFTIO_HEAD_TYPE_READ)
+#define SOFTIO_HOOK_ON_WRITE SOFTIO_HOOK_ON_TYPE(SOFTIO_HEAD_TYPE_WRITE)
+#define SOFTIO_HOOK_ON_FIFO (SOFTIO_HOOK_ON_TYPE(SOFTIO_HEAD_TYPE_READ_FIFO) | SOFTIO_HOOK_ON_TYPE(SOFTIO_HEAD_TYPE_WRITE_FIFO) | \
+	SOFTIO_HOOK_ON_TYPE(SOFTIO_HEAD_TYPE_CLEAR_FIFO) | SOFTIO_HOOK_ON_TYPE(SOFTIO_HEAD_TYPE_RESET_FIFO))
+typedef struct {
+	uint32_t begin;
+	uint32_t end;
+	uint32_t types;
+#ifndef SOFTIO_USE_FUNCTION
+	void (*before) (void* softio, SoftIO_Head_t* head);
+	void (*after) (void* softio, SoftIO_Head_t* head);
+#else
+	std::function<void(void*, SoftIO_Head_t*)> before;
+	std::function<void(void*, SoftIO_Head_t*)> after;
+#endif
+} SoftIO_Hook_t;
+
+typedef struct {
+	uint32_t addr;
+	uint16_t length;  // 0 if not used
+	uint16_t period;
+	uint8_t flags;
+	uint32_t last;  // (slave) tick of last check
+	uint32_t hash;  // (slave) hash of data at last push, for SOFTIO_SUB_ON_CHANGE
+#ifndef SOFTIO_USE_FUNCTION
+	void (*callback) (void* softio, uint32_t id);  // (host) called after pushed data is in local memory
+#else
+	std::function<void(void*, uint32_t)> callback;
+#endif
+} SoftIO_Sub_t;
+// a stored program being built by host, see SOFTIO_PROG_WAIT. it's in local memory and uploaded to the same place of remote
+typedef struct {
+	uint32_t addr;  // relative to base
+	uint16_t size;  // bytes available
+	uint16_t length;  // bytes used
+	uint16_t reply;  // data length of reply at most, including the executed count
+	uint8_t count;  // instructions
+} SoftIO_Prog_t;
+#define SOFTIO_REGION(var) { (void*)&(var), sizeof(var) }
+#define SOFTIO_REGION_BETWEEN(var1, var2) { (void*)&(var1), (uint32_t)((char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2)) }
+
 typedef struct {
 	// uint8_t status;  // TODO
 	uint16_t length;  // a simple fifo here
 	uint16_t write;
 	uint16_t read;
-	SoftIO_Head_t transactions[SOFTIO_HEAD_LENGTH];
+	SoftIO_Trans_t* transactions;  // the window, points to transaction_buffer unless softio_set_window is called
+	SoftIO_Trans_t transaction_buffer[SOFTIO_HEAD_LENGTH];
+	uint16_t region_write;  // the ring of multi read regions, only used by host
+	uint16_t region_read;
+	SoftIO_Head_t regions[SOFTIO_REGION_LENGTH];
+	uint32_t features;  // features of remote side, see SOFTIO_FEATURE_xxx. only used by host
+// credit flow control: host never has more than credit_capacity bytes which are not consumed by remote, so remote rx never overflows.
+//   counters are 16bit and wrap, they restart from the SOFTIO_EXT_CREDIT request
+	uint16_t credit_capacity;  // (host) remote rx capacity, 0 if credit flow control is not enabled
+	uint16_t credit_sent;  // (host) bytes put into tx
+	uint16_t credit_acked;  // (host) bytes consumed by remote, as reported
+	uint16_t credit_consumed;  // (slave) bytes consumed from rx
+	uint16_t credit_reported;  // (slave) the last credit_consumed reported to host
+	char credit_reporting;  // (slave) whether host has enabled credit flow control
+// dirty tracking: shadow holds what remote has for [shadow_begin, shadow_end) of memory, it's updated by every write sent and
+//   every read returned. softio_delay_sync_dirty writes the bytes which differ from shadow. only used by host
+	char* shadow;  // NULL if not tracking
+	uint32_t shadow_begin;
+	uint32_t shadow_end;
+	char* shadow_fields;  // NULL, or an id for each tracked byte of a field with write hooks on remote (0 for others), see softio_track_hooked
+	SoftIO_Sub_t subs[SOFTIO_SUB_LENGTH];
+	uint8_t subscribed;  // (slave) count of active subscriptions
+	uint8_t executed;  // (host) instructions executed by the last program returned, less than its count if stopped by a wait
+// resync: a side finding a corrupt frame discards it instead of asserting, see __softio_error. counters are 16bit and wrap
+	uint8_t resync;  // SOFTIO_RESYNC_xxx while discarding rx, otherwise 0
+	uint16_t errors;  // corrupt frames found by this side
+	const char* error;  // reason of the last one, for debugging
+	uint16_t handled;  // (slave) requests handled, not including SOFTIO_EXT_SYNC
+	uint16_t issued;  // (host) requests sent, counted the same way so that it equals handled of remote after all are handled
+	uint16_t lost;  // (host) transactions dropped by resync, since remote has discarded them (e.g., posted writes) or their reply
+	uint16_t sync_id;  // (host) id of the last SOFTIO_EXT_SYNC
+	uint16_t sync_sent;  // (host) credit_sent right after it
+	uint16_t replay;  // (host) the last `replay` transactions of the window are kept by resync and not sent yet
+	uint32_t stall_count;  // bytes of the partial frame in rx, 0 if none
+	uint32_t stall_tick;  // since when it doesn't grow
+	SoftIO_Head_t tagged[SOFTIO_TAG_LENGTH];  // read of each tag, as a legacy head
+	uint32_t tags;  // (host) mask of tags waiting for the reply
+	uint32_t deferred;  // (slave) mask of tags not replied yet
+	uint32_t tag_replay;  // (host) tags kept by resync and not sent yet
+	SoftIO_Hook_t* hooks;  // (slave) registry sorted by address without overlap, see softio_set_hooks
+	uint16_t hook_count;
+	uint16_t hook_capacity;
+	uint32_t hook_types;  // types of all hooks, so that other requests (e.g., bulk fifo ones) skip the search
 	char* base;  // the base pointer of memory
 	uint32_t size;  // the size of memory
 	Fifo_t* rx;
@@ -102,12 +411,20 @@ typedef struct {
 	uint32_t fifo_end;
 #ifndef SOFTIO_USE_FUNCTION
 // check function: you can define the restricted area of operation or anything else you like
-// you can even redirect read/write by set the addr in head!
+// you can even redirect read/write by set the addr in head! (each region of a multi read too, but not extended read/write of SOFTIO_EXT_xxx)
 	void (*before) (void* softio, SoftIO_Head_t* head);
 // after function: you can process something after host read/write some memory from/to you
 	void (*after) (void* softio, SoftIO_Head_t* head);
 // callback function: read/write request fininsh callback
 	void (*callback) (void* softio, SoftIO_Head_t* head);
+// tick function: monotonic time in any unit (e.g., HAL_GetTick) for periods of subscriptions. if NULL, they're always due
+	uint32_t (*tick) ();
+// ready function: polled by slave for a deferred tagged read until it returns non-zero, e.g., when a conversion started by it is done.
+//   before hooks are called after that, so they could take the result without waiting. NULL means always ready
+	int (*ready) (void* softio, SoftIO_Head_t* head);
+// lock and unlock function: around atomic operations, e.g., disable and enable interrupts. keep it as short as possible
+	void (*lock) ();
+	void (*unlock) ();
 
 // the following needs to be implemented
 	size_t (*available) ();  // this will return current available bytes to gets(), useful to try handle
@@ -122,6 +439,10 @@ typedef struct {
 	std::function<void(void*, SoftIO_Head_t*)> before;
 	std::function<void(void*, SoftIO_Head_t*)> after;
 	std::function<void(void*, SoftIO_Head_t*)> callback;
+	std::function<uint32_t()> tick;
+	std::function<int(void*, SoftIO_Head_t*)> ready;
+	std::function<void()> lock;
+	std::function<void()> unlock;
 	std::function<size_t()> available;
 	std::function<size_t(char*, size_t)> gets;
 	std::function<size_t(char*, size_t)> puts;
@@ -138,15 +459,57 @@ static inline void softio_init(SoftIO_t* softio, void* base, uint32_t size, Fifo
 	softio->length = SOFTIO_HEAD_LENGTH;
 	softio->read = 0;
 	softio->write = 0;
+	softio->transactions = softio->transaction_buffer;
+	softio->region_write = 0;
+	softio->region_read = 0;
 	softio->base = (char*)base;
 	softio->size = size;
 	softio->rx = rx;
 	softio->tx = tx;
 	softio->fifo_begin = (char*)rx - (char*)base;
 	softio->fifo_end = size;
+	softio->features = 0;  // legacy until handshake
+	softio->credit_capacity = 0;
+	softio->credit_sent = 0;
+	softio->credit_acked = 0;
+	softio->credit_consumed = 0;
+	softio->credit_reported = 0;
+	softio->credit_reporting = 0;
+	softio->shadow = NULL;
+	softio->shadow_begin = 0;
+	softio->shadow_end = 0;
+	softio->shadow_fields = NULL;
+	for (int i=0; i<SOFTIO_SUB_LENGTH; ++i) {
+		softio->subs[i].length = 0;
+		softio->subs[i].callback = NULL;
+	}
+	softio->subscribed = 0;
+	softio->executed = 0;
+	softio->resync = 0;
+	softio->errors = 0;
+	softio->error = NULL;
+	softio->handled = 0;
+	softio->issued = 0;
+	softio->lost = 0;
+	softio->sync_id = 0;
+	softio->sync_sent = 0;
+	softio->replay = 0;
+	softio->stall_count = 0;
+	softio->stall_tick = 0;
+	softio->tags = 0;
+	softio->deferred = 0;
+	softio->tag_replay = 0;
+	softio->hooks = NULL;
+	softio->hook_count = 0;
+	softio->hook_capacity = 0;
+	softio->hook_types = 0;
 	softio->before = NULL;
 	softio->after = NULL;
 	softio->callback = NULL;
+	softio->tick = NULL;
+	softio->ready = NULL;
+	softio->lock = NULL;
+	softio->unlock = NULL;
 	softio->gets = NULL;
 	softio->puts = NULL;
 	softio->yield = NULL;
@@ -158,25 +521,710 @@ static inline void softio_init(SoftIO_t* softio, void* base, uint32_t size, Fifo
 	softio_init(&(sio), &(mem), sizeof(mem), &((mem).siorx), &((mem).siotx)); \
 } while (0)
 
+// hook registry: a table provided by user, hooks are inserted by softio_hook in order of address.
+//   a request only calls hooks it includes, which are found by binary search, so there could be hundreds of them
+static inline void __softio_set_hooks(SoftIO_t* softio, SoftIO_Hook_t* hooks, uint16_t capacity) {
+	softio->hooks = hooks;
+	softio->hook_count = 0;
+	softio->hook_capacity = capacity;
+	softio->hook_types = 0;
+}
+#define softio_set_hooks(softio, hooks, capacity) __softio_set_hooks(&(softio), hooks, capacity)
+#ifndef SOFTIO_USE_FUNCTION
+static inline void __softio_hook(SoftIO_t* softio, void* addr, uint32_t length, uint32_t types,
+		void (*before) (void* softio, SoftIO_Head_t* head), void (*after) (void* softio, SoftIO_Head_t* head)) {
+#else
+static inline void __softio_hook(SoftIO_t* softio, void* addr, uint32_t length, uint32_t types,
+		std::function<void(void*, SoftIO_Head_t*)> before, std::function<void(void*, SoftIO_Head_t*)> after) {
+#endif
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && length && "hook outside shared space");
+	assert(softio->hook_count < softio->hook_capacity && "hook table is full");
+	uint32_t begin = (char*)addr - softio->base;
+	uint32_t i = softio->hook_count;
+	for (; i > 0 && softio->hooks[i-1].begin > begin; --i) softio->hooks[i] = softio->hooks[i-1];  // insertion sort
+	assert((i == 0 || softio->hooks[i-1].end <= begin) && (i == softio->hook_count || begin + length <= softio->hooks[i+1].begin) && "hooks overlap");
+	softio->hooks[i].begin = begin;
+	softio->hooks[i].end = begin + length;
+	softio->hooks[i].types = types;
+	softio->hooks[i].before = before;
+	softio->hooks[i].after = after;
+	++softio->hook_count;
+	softio->hook_types |= types;
+}
+#define softio_hook(softio, var, types, before, after) __softio_hook(&(softio), &(var), sizeof(var), types, before, after)
+#define softio_hook_between(softio, var1, var2, types, before, after) __softio_hook(&(softio), &(var1), \
+	(char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2), types, before, after)
+static inline void __softio_call_hooks(SoftIO_t* softio, SoftIO_Head_t* head, char after) {
+	uint32_t type = SOFTIO_HOOK_ON_TYPE(head->type);
+	if (!(softio->hook_types & type)) return;
+	uint32_t begin = head->addr;
+	uint32_t end = begin + (head->type == SOFTIO_HEAD_TYPE_READ || head->type == SOFTIO_HEAD_TYPE_WRITE ? head->length : sizeof(Fifo_t));
+	uint32_t lo = 0, hi = softio->hook_count;
+	while (lo < hi) {  // the first hook begins inside
+		uint32_t mid = (lo + hi) / 2;
+		if (softio->hooks[mid].begin < begin) lo = mid + 1;
+		else hi = mid;
+	}
+	for (SoftIO_Hook_t* hook = softio->hooks + lo; hook < softio->hooks + softio->hook_count && hook->begin < end; ++hook) {
+		if (hook->end > end || !(hook->types & type)) continue;
+		if (after) { if (hook->after) hook->after(softio, head); }
+		else { if (hook->before) hook->before(softio, head); }
+	}
+}
+// the global hook is called first before, and last after
+static inline void __softio_before(SoftIO_t* softio, SoftIO_Head_t* head) {
+	if (softio->before) softio->before(softio, head);
+	__softio_call_hooks(softio, head, 0);
+}
+static inline void __softio_after(SoftIO_t* softio, SoftIO_Head_t* head) {
+	__softio_call_hooks(softio, head, 1);
+	if (softio->after) softio->after(softio, head);
+}
+
 // successfully handle one returns 0, otherwise return the byte needed (including existed) to read (>0), or the byte need to write (total) (<0)
 #define SOFTIO_HANDLE_NEED_READ(need) if ( fifo_count(softio->rx) < (need) ) return (need)
 #define SOFTIO_HANDLE_NEED_WRITE(need) if ( fifo_remain(softio->tx) < (need) ) return - (need)
-static inline int __softio_try_handle_one(SoftIO_t* softio) {
+// checks of received frames, a corrupt one is discarded with resync rather than asserting, see __softio_error. heads are not covered by
+//   the checksum, so a flipped address bit goes undetected. a corrupt length of a request is found by the stall check of slave (see
+//   __softio_check_stall), but nothing is found when frames are lost as a whole: host resyncs at the timeout of gets (SOFTIO_RESYNC_TIMEOUT
+//   while a resync is pending), so a transport without timeout never recovers from them
+#define SOFTIO_CHECK(cond, reason) do { if (!(cond)) return __softio_error(softio, SOFTIO_RESYNC_REQUEST, reason); } while (0)  // request
+#define SOFTIO_CHECK_RET(cond, reason) do { if (!(cond)) return __softio_error(softio, SOFTIO_RESYNC_REPLY, reason); } while (0)  // reply
+static inline uint32_t __softio_preread_u16(Fifo_t* fifo, uint32_t index) {  // little endian
+	return (uint32_t)(unsigned char)fifo_preread(fifo, index) | ((uint32_t)(unsigned char)fifo_preread(fifo, index + 1) << 8);
+}
+
+// remote has the data of src in [addr, addr+length), copy the tracked part into shadow
+static inline void __softio_shadow_set(SoftIO_t* softio, uint32_t addr, const char* src, uint32_t length) {
+	if (!softio->shadow) return;
+	uint32_t begin = addr > softio->shadow_begin ? addr : softio->shadow_begin;
+	uint32_t end = addr + length < softio->shadow_end ? addr + length : softio->shadow_end;
+	if (begin < end) memcpy(softio->shadow + (begin - softio->shadow_begin), src + (begin - addr), end - begin);
+}
+// remote has the same data as local memory in [addr, addr+length)
+#define __softio_shadow_update(softio, addr, length) __softio_shadow_set(softio, addr, (softio)->base + (addr), length)
+
+// extended transactions are presented to before/after as legacy heads of at most 254 bytes,
+//   so that existing hooks see exactly the same heads as if host has split the transaction itself
+static inline void __softio_hook_pieces(SoftIO_t* softio, uint32_t type, uint32_t addr, uint32_t length, char after) {
+	SoftIO_Head_t head;
+	for (uint32_t bias=0; bias<length; bias+=254) {
+		head.type = type;
+		head.addr = addr + bias;
+		head.length = (length - bias) > 254 ? 254 : (length - bias);
+		if (after) __softio_after(softio, &head);
+		else __softio_before(softio, &head);
+	}
+}
+
+static inline void __softio_extend_ret_enque(Fifo_t* tx, uint32_t op, uint32_t xlength) {
+	char ret[4] = { (char)(SOFTIO_HEAD_TYPE_EXTEND | 0x01), (char)op, (char)xlength, (char)(xlength >> 8) };
+	fifo_copy_from_buffer(tx, ret, 4);
+}
+
+// a corrupt frame is found, count it and start resync. return 0 so that handling goes on by discarding rx:
+//   slave pushes SOFTIO_EXT_ERROR_REPORT and discards rx until a SOFTIO_EXT_SYNC request, then handles requests after it as usual.
+//   host sends SOFTIO_EXT_SYNC and discards rx until its reply, which tells how many requests remote has handled. transactions
+//   not handled are sent again, as well as reads whose reply is discarded, see __softio_resynced. host asserts if remote cannot resync
+static inline void __softio_sync(SoftIO_t* softio);
+static inline int __softio_error(SoftIO_t* softio, uint32_t resync, const char* reason) {
+	++softio->errors;
+	softio->error = reason;
+	// a slave never gets replies, and a host never gets requests: a reply with a flipped type bit looks like one, whose marker never comes
+	if (!softio->puts && !(softio->features & SOFTIO_FEATURE_RESYNC)) resync = SOFTIO_RESYNC_REQUEST;
+	else if (softio->features & SOFTIO_FEATURE_RESYNC) resync = SOFTIO_RESYNC_REPLY;
+	if (resync == SOFTIO_RESYNC_REQUEST) {
+		if (!softio->resync && fifo_remain(softio->tx) >= 4) __softio_extend_ret_enque(softio->tx, SOFTIO_EXT_ERROR_REPORT, softio->errors);
+		softio->resync = SOFTIO_RESYNC_REQUEST;
+	} else __softio_sync(softio);
+	return 0;
+}
+// discard rx until the marker of resync: a SOFTIO_EXT_SYNC request (slave), or its reply with sync_id (host)
+static inline int __softio_resync_scan(SoftIO_t* softio) {
+	char marker[4];
+	if (softio->resync == SOFTIO_RESYNC_REQUEST) {
+		SoftIO_Head_t head;
+		head.type = SOFTIO_HEAD_TYPE_EXTEND; head.addr = SOFTIO_SYNC_MAGIC; head.length = SOFTIO_EXT_SYNC;
+		memcpy(marker, &head, 4);
+	} else {
+		marker[0] = SOFTIO_HEAD_TYPE_EXTEND | 0x01; marker[1] = SOFTIO_EXT_SYNC;
+		marker[2] = softio->sync_id; marker[3] = softio->sync_id >> 8;
+	}
+	while (!fifo_empty(softio->rx)) {
+		uint32_t count = fifo_count(softio->rx) < 4 ? fifo_count(softio->rx) : 4, i = 0;
+		while (i < count && fifo_preread(softio->rx, i) == marker[i]) ++i;
+		if (i == 4) {
+			softio->resync = 0;
+			return 0;
+		}
+		if (i == count) return 4;  // could be the marker
+		fifo_skip(softio->rx, 1);
+	}
+	return 1;
+}
+
+// sanity check of a stored program before running any of it, return data length of reply at most, or 0 with softio->error if invalid
+#define SOFTIO_PROG_CHECK(cond, reason) do { if (!(cond)) { softio->error = reason; return 0; } } while (0)
+static inline uint32_t __softio_prog_check(SoftIO_t* softio, const char* prog, uint32_t length) {
+	uint32_t reply = 1, count = 0, step;
+	SoftIO_Head_t head;
+	for (uint32_t i=0; i<length; i+=step, ++count) {
+		SOFTIO_PROG_CHECK(i + 4 <= length, "program truncated");
+		memcpy(&head, prog + i, sizeof(head));
+		step = __softio_prog_step(prog + i);
+		SOFTIO_PROG_CHECK(i + step <= length, "program truncated");
+		switch (head.type) {
+		case SOFTIO_HEAD_TYPE_READ:
+		case SOFTIO_HEAD_TYPE_WRITE:
+			SOFTIO_PROG_CHECK(head.length != 0 && head.length != 255, "invalid length");
+			SOFTIO_PROG_CHECK((uint32_t)(head.addr + head.length) <= softio->size, "program access outside shared space");
+			if (head.type == SOFTIO_HEAD_TYPE_READ) reply += head.length;
+			break;
+		case SOFTIO_HEAD_TYPE_READ_FIFO:
+		case SOFTIO_HEAD_TYPE_CLEAR_FIFO:
+		case SOFTIO_HEAD_TYPE_RESET_FIFO:
+			SOFTIO_PROG_CHECK((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end, "program fifo outside valid space");
+			SOFTIO_PROG_CHECK((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0, "program fifo alignment error");
+			SOFTIO_PROG_CHECK((head.type == SOFTIO_HEAD_TYPE_READ_FIFO) == (head.length != 0 && head.length != 255), "invalid length");
+			if (head.type == SOFTIO_HEAD_TYPE_READ_FIFO) reply += 1 + head.length;
+			break;
+		case SOFTIO_PROG_WAIT:
+			SOFTIO_PROG_CHECK((head.length == 1 || head.length == 2 || head.length == 4), "invalid wait variable");
+			SOFTIO_PROG_CHECK((uint32_t)(head.addr + head.length) <= softio->size, "program access outside shared space");
+			break;
+		default:
+			SOFTIO_PROG_CHECK(0, "invalid program instruction");
+		}
+	}
+	SOFTIO_PROG_CHECK(count <= 255, "too many instructions");
+	return reply;
+}
+
+// put data at `offset` bytes after the write pointer of tx without making them visible, so that the length of reply could be
+//   written at last. not safe beyond fifo_remain. return the sum of data
+static inline char __softio_tx_stage(Fifo_t* tx, uint32_t offset, const char* buf, uint32_t length) {
+	uint32_t start = __fifo_pos(tx, __fifo_next(tx, tx->write, offset));
+	uint32_t len = __fifo_contiguous(tx, start);
+	if (len >= length) memcpy(__FIFO_GET_BASE(tx) + start, buf, length);
+	else {
+		memcpy(__FIFO_GET_BASE(tx) + start, buf, len);
+		memcpy(__FIFO_GET_BASE(tx), buf + len, length - len);
+	}
+	return __softio_sum(buf, length);
+}
+
+// (slave) condition of SOFTIO_PROG_WAIT, with tick the timeout is checked, otherwise it's checked only once
+static inline char __softio_prog_wait_cond(SoftIO_t* softio, SoftIO_Head_t* head, const char* arg) {
+	uint32_t mask, value, timeout = (uint32_t)(unsigned char)arg[8] | ((uint32_t)(unsigned char)arg[9] << 8);
+	memcpy(&mask, arg, 4);
+	memcpy(&value, arg + 4, 4);
+	if (timeout > SOFTIO_PROG_WAIT_MAX) timeout = SOFTIO_PROG_WAIT_MAX;  // from a host built with a larger limit
+	uint32_t start = softio->tick ? softio->tick() : 0;
+	while (1) {
+		uint32_t var = 0;
+		memcpy(&var, softio->base + head->addr, head->length);  // little endian
+		if ((var & mask) == value) return 1;
+		if (!softio->tick || (uint32_t)(softio->tick() - start) >= timeout) return 0;
+		if (softio->yield) softio->yield();
+	}
+}
+
+// (slave) run a checked program, the whole reply is staged and made visible at once
+static inline void __softio_prog_run(SoftIO_t* softio, const char* prog, uint32_t length) {
+	Fifo_t* tx = softio->tx;
+	uint32_t offset = 5;  // type, opcode, xlength and executed count are staged at last
+	uint32_t executed = 0;
+	SoftIO_Head_t head;
+	Fifo_t* fptr;
+	char sum = 0;
+	for (uint32_t i=0; i<length; i+=__softio_prog_step(prog + i), ++executed) {
+		memcpy(&head, prog + i, sizeof(head));
+		if (head.type == SOFTIO_PROG_WAIT) {
+			if (!__softio_prog_wait_cond(softio, &head, prog + i + 4)) break;  // timeout, stop here
+			continue;
+		}
+		__softio_before(softio, &head);
+		switch (head.type) {
+		case SOFTIO_HEAD_TYPE_READ:
+			sum += __softio_tx_stage(tx, offset, softio->base + head.addr, head.length);
+			offset += head.length;
+			break;
+		case SOFTIO_HEAD_TYPE_WRITE:
+			memcpy(softio->base + head.addr, prog + i + 4, head.length);
+			break;
+		case SOFTIO_HEAD_TYPE_READ_FIFO: {
+			fptr = (Fifo_t*)(softio->base + head.addr);
+			Fifo_Spans_t spans;
+			uint32_t count = fifo_read_spans(fptr, &spans, head.length);  // a snapshot, producer may add more meanwhile
+			char c = count;
+			sum += __softio_tx_stage(tx, offset++, &c, 1);
+			sum += __softio_tx_stage(tx, offset, spans.ptr[0], spans.len[0]);
+			sum += __softio_tx_stage(tx, offset + spans.len[0], spans.ptr[1], spans.len[1]);
+			fifo_read_commit(fptr, count);
+			offset += count;
+			break; }
+		case SOFTIO_HEAD_TYPE_CLEAR_FIFO:
+			fifo_clear((Fifo_t*)(softio->base + head.addr));
+			break;
+		case SOFTIO_HEAD_TYPE_RESET_FIFO:
+			fptr = (Fifo_t*)(softio->base + head.addr);
+			fptr->write = 0; fptr->read = 0;
+			break;
+		}
+		__softio_after(softio, &head);
+	}
+	char ret[5] = { (char)(SOFTIO_HEAD_TYPE_EXTEND | 0x01), (char)SOFTIO_EXT_RUN, (char)(offset - 4), (char)((offset - 4) >> 8), (char)executed };
+	sum += ret[4];
+	__softio_tx_stage(tx, 0, ret, 5);
+	char c = -sum;
+	__softio_tx_stage(tx, offset, &c, 1);
+	tx->write = __fifo_next(tx, tx->write, offset + 1);
+}
+
+// (host) scatter data of a program reply into local memory and update shadow by executed writes.
+//   the program in local memory must not be changed before it returns
+static inline void __softio_prog_scatter(SoftIO_t* softio, SoftIO_Trans_t* tptr, uint32_t xlength) {
+	const char* prog = softio->base + tptr->head.addr;
+	uint32_t consumed = 1, count;
+	SoftIO_Head_t head;
+	softio->executed = (unsigned char)fifo_deque(softio->rx);
+	for (uint32_t i=0, n=0; n<softio->executed; i+=__softio_prog_step(prog + i), ++n) {
+		assert(i < tptr->xlength && "executed more than the program");
+		memcpy(&head, prog + i, sizeof(head));
+		if (head.type == SOFTIO_HEAD_TYPE_READ) {
+			fifo_move_to_buffer(softio->base + head.addr, softio->rx, head.length);
+			__softio_shadow_update(softio, head.addr, head.length);
+			consumed += head.length;
+		} else if (head.type == SOFTIO_HEAD_TYPE_READ_FIFO) {
+			count = (unsigned char)fifo_deque(softio->rx);
+			assert(count <= head.length && "read fifo transaction length greater");
+			Fifo_t* fptr = (Fifo_t*)(softio->base + head.addr);
+			assert(count <= fifo_remain(fptr) && "local fifo is not enough to read");
+			__softio_fifo_move_sum(fptr, softio->rx, count);
+			consumed += 1 + count;
+		} else if (head.type == SOFTIO_HEAD_TYPE_WRITE) __softio_shadow_set(softio, head.addr, prog + i + 4, head.length);
+	}
+	assert(consumed == xlength && "program reply length not equal");
+}
+
+// (slave) operation and operands are at the front of rx. hooks see a write of the word, the word is changed inside lock and unlock
+static inline void __softio_atomic(SoftIO_t* softio, SoftIO_Head_t* head, uint32_t width) {
+	char arg[9];
+	uint32_t a, b, old, value;
+	fifo_move_to_buffer(arg, softio->rx, 9);
+	fifo_skip(softio->rx, 1);  // get checksum outside
+	memcpy(&a, arg + 1, 4);  // little endian
+	memcpy(&b, arg + 5, 4);
+	head->type = SOFTIO_HEAD_TYPE_WRITE;
+	head->length = width;
+	__softio_before(softio, head);
+	char* word = softio->base + head->addr;
+	if (softio->lock) softio->lock();
+	if (width == 1) old = *(uint8_t*)word;  // a single load and store of aligned word
+	else if (width == 2) old = *(uint16_t*)(void*)word;
+	else old = *(uint32_t*)(void*)word;
+	value = __softio_atomic_apply((unsigned char)arg[0], old, a, b, width);
+	if (width == 1) *(uint8_t*)word = value;
+	else if (width == 2) *(uint16_t*)(void*)word = value;
+	else *(uint32_t*)(void*)word = value;
+	if (softio->unlock) softio->unlock();
+	__softio_after(softio, head);
+	char ret[8];
+	memcpy(ret, &old, width);
+	memcpy(ret + width, &value, width);
+	__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_ATOMIC, width);
+	__softio_enque_sum(softio->tx, ret, 2 * width);
+}
+
+static inline int __softio_try_handle_extend(SoftIO_t* softio) {
+	SOFTIO_HANDLE_NEED_READ(6);  // head and xlength not ready
+	SoftIO_Head_t head;
+	__softio_head_preread(softio->rx, &head);  // do not get the head, simply because data may not available now
+	uint32_t xlength = __softio_preread_u16(softio->rx, 4);
+	uint32_t length;
+	SoftIO_Head_t region;
+	char sum;
+	switch (head.length) {
+	case SOFTIO_EXT_READ:
+		SOFTIO_CHECK(xlength != 0 && (uint32_t)(head.addr + xlength) <= softio->size, "read outside shared space");
+		SOFTIO_CHECK(5 + xlength <= fifo_capacity(softio->tx), "reply larger than tx fifo");
+		SOFTIO_HANDLE_NEED_WRITE(5 + xlength);  // fifo is not ready for reply
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		__softio_hook_pieces(softio, SOFTIO_HEAD_TYPE_READ, head.addr, xlength, 0);
+		__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_READ, xlength);
+		__softio_enque_sum(softio->tx, softio->base + head.addr, xlength);
+		__softio_hook_pieces(softio, SOFTIO_HEAD_TYPE_READ, head.addr, xlength, 1);
+		break;
+	case SOFTIO_EXT_WRITE:
+	case SOFTIO_EXT_WRITE_POSTED:
+		SOFTIO_CHECK(xlength != 0 && (uint32_t)(head.addr + xlength) <= softio->size, "write outside shared space");
+		SOFTIO_CHECK(7 + xlength <= fifo_capacity(softio->rx), "request larger than rx fifo");
+		SOFTIO_HANDLE_NEED_READ(6 + xlength + 1);  // data not ready
+		if (head.length == SOFTIO_EXT_WRITE) SOFTIO_HANDLE_NEED_WRITE(4);  // fifo is not ready for reply
+		sum = __softio_fifo_sum(softio->rx, 6, xlength + 1);  // including checksum
+		SOFTIO_CHECK(sum == 0, "check sum failed for write");
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		__softio_hook_pieces(softio, SOFTIO_HEAD_TYPE_WRITE, head.addr, xlength, 0);
+		fifo_move_to_buffer(softio->base + head.addr, softio->rx, xlength);  // actually write into local memory
+		fifo_skip(softio->rx, 1);  // get checksum outside
+		if (head.length == SOFTIO_EXT_WRITE) __softio_extend_ret_enque(softio->tx, SOFTIO_EXT_WRITE, xlength);
+		__softio_hook_pieces(softio, SOFTIO_HEAD_TYPE_WRITE, head.addr, xlength, 1);
+		break;
+	case SOFTIO_EXT_FENCE:
+		SOFTIO_CHECK(xlength == 0, "invalid length, must be 0");
+		SOFTIO_HANDLE_NEED_WRITE(4);  // fifo is not ready for reply
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_FENCE, 0);  // requests are handled in order, so everything before is done
+		break;
+	case SOFTIO_EXT_CREDIT:
+		SOFTIO_CHECK(xlength == 0, "invalid length, must be 0");
+		SOFTIO_HANDLE_NEED_WRITE(6);  // fifo is not ready for reply
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		length = fifo_capacity(softio->rx);
+		if (length > 0xFFFF) length = 0xFFFF;
+		softio->credit_reporting = 1;
+		softio->credit_consumed = 0;  // this request is counted after return
+		softio->credit_reported = 6;  // host knows this request is consumed when it gets the reply
+		__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_CREDIT, 0);
+		fifo_enque(softio->tx, length);
+		fifo_enque(softio->tx, length >> 8);
+		break;
+	case SOFTIO_EXT_SUBSCRIBE:
+		SOFTIO_CHECK(6 + xlength <= fifo_capacity(softio->tx), "push larger than tx fifo");
+		SOFTIO_HANDLE_NEED_READ(6 + 4 + 1);  // id, flags, period and checksum not ready
+		SOFTIO_HANDLE_NEED_WRITE(4);  // fifo is not ready for reply
+		sum = __softio_fifo_sum(softio->rx, 6, 4 + 1);
+		SOFTIO_CHECK(sum == 0, "check sum failed for subscribe");
+		length = (unsigned char)fifo_preread(softio->rx, 6);  // id
+		SOFTIO_CHECK(length < SOFTIO_SUB_LENGTH, "invalid subscription id");
+		if (xlength && (fifo_preread(softio->rx, 7) & SOFTIO_SUB_FIFO)) {
+			SOFTIO_CHECK(xlength < 255, "fifo push length invalid");
+			SOFTIO_CHECK((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end, "push fifo outside valid space");
+			SOFTIO_CHECK((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0, "push fifo alignment error");
+		} else SOFTIO_CHECK((uint32_t)(head.addr + xlength) <= softio->size, "subscribe outside shared space");
+		if (softio->subs[length].length) --softio->subscribed;
+		if (xlength) ++softio->subscribed;
+		softio->subs[length].addr = head.addr;
+		softio->subs[length].length = xlength;
+		softio->subs[length].flags = (unsigned char)fifo_preread(softio->rx, 7) & ~SOFTIO_SUB_PUSHED;
+		softio->subs[length].period = __softio_preread_u16(softio->rx, 8);
+		fifo_skip(softio->rx, 6 + 4 + 1);
+		__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_SUBSCRIBE, xlength);
+		break;
+	case SOFTIO_EXT_RUN:
+		SOFTIO_CHECK(xlength != 0 && (uint32_t)(head.addr + xlength) <= softio->size, "program outside shared space");
+		length = __softio_prog_check(softio, softio->base + head.addr, xlength);
+		SOFTIO_CHECK(length != 0, softio->error);
+		SOFTIO_CHECK(5 + length <= fifo_capacity(softio->tx), "reply larger than tx fifo");
+		SOFTIO_HANDLE_NEED_WRITE(5 + length);  // fifo is not ready for reply
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		__softio_prog_run(softio, softio->base + head.addr, xlength);
+		break;
+	case SOFTIO_EXT_ATOMIC:
+		SOFTIO_CHECK((xlength == 1 || xlength == 2 || xlength == 4) && head.addr % xlength == 0, "invalid atomic word");
+		SOFTIO_CHECK((uint32_t)(head.addr + xlength) <= softio->size, "atomic outside shared space");
+		SOFTIO_HANDLE_NEED_READ(6 + 9 + 1);  // operation, operands and checksum not ready
+		SOFTIO_HANDLE_NEED_WRITE(5 + 2 * xlength);  // fifo is not ready for reply
+		sum = __softio_fifo_sum(softio->rx, 6, 9 + 1);
+		SOFTIO_CHECK(sum == 0, "check sum failed for atomic");
+		SOFTIO_CHECK((unsigned char)fifo_preread(softio->rx, 6) <= SOFTIO_ATOMIC_MASKED, "invalid atomic operation");
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		__softio_atomic(softio, &head, xlength);
+		break;
+	case SOFTIO_EXT_SYNC: {
+		SOFTIO_CHECK(head.addr == SOFTIO_SYNC_MAGIC, "invalid sync");
+		SOFTIO_HANDLE_NEED_WRITE(7);  // fifo is not ready for reply
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		char handled[2] = { (char)softio->handled, (char)(softio->handled >> 8) };
+		__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_SYNC, xlength);
+		__softio_enque_sum(softio->tx, handled, 2);
+		if (softio->credit_reporting) {  // restart as SOFTIO_EXT_CREDIT, since host doesn't know how many bytes are discarded
+			softio->credit_consumed = 0;  // this request is counted after return
+			softio->credit_reported = 6;
+		}
+		softio->deferred = 0;  // host sends them again
+		return 0; }  // not counted as handled
+	case SOFTIO_EXT_READ_TAGGED:
+		SOFTIO_CHECK(xlength != 0 && xlength < 255 && (uint32_t)(head.addr + xlength) <= softio->size, "read outside shared space");
+		SOFTIO_CHECK(6 + xlength <= fifo_capacity(softio->tx), "reply larger than tx fifo");
+		SOFTIO_HANDLE_NEED_READ(6 + 1);  // tag not ready
+		length = (unsigned char)fifo_preread(softio->rx, 6);
+		SOFTIO_CHECK(length < SOFTIO_TAG_LENGTH && !(softio->deferred & (1u << length)), "invalid tag");
+		fifo_skip(softio->rx, 6 + 1);  // really get head, xlength and tag
+		softio->tagged[length].type = SOFTIO_HEAD_TYPE_READ;
+		softio->tagged[length].addr = head.addr;
+		softio->tagged[length].length = xlength;
+		softio->deferred |= 1u << length;  // replied by __softio_complete_tagged
+		break;
+	case SOFTIO_EXT_READ_MULTI:
+		SOFTIO_CHECK(xlength != 0 && 7 + 4 * xlength <= fifo_capacity(softio->rx), "request larger than rx fifo");
+		SOFTIO_HANDLE_NEED_READ(6 + 4 * xlength + 1);  // regions not ready
+		sum = __softio_fifo_sum(softio->rx, 6, 4 * xlength + 1);  // including checksum
+		SOFTIO_CHECK(sum == 0, "check sum failed for regions");
+		length = 0; for (uint32_t i=0; i<xlength; ++i) {  // sanity check and get total length
+			__softio_head_preread_at(softio->rx, 6 + 4 * i, &region);
+			SOFTIO_CHECK(region.type == SOFTIO_HEAD_TYPE_READ && region.length != 0 && region.length != 255, "invalid region");
+			SOFTIO_CHECK((uint32_t)(region.addr + region.length) <= softio->size, "read outside shared space");
+			length += region.length;
+		}
+		SOFTIO_CHECK(5 + length <= fifo_capacity(softio->tx), "reply larger than tx fifo");
+		SOFTIO_HANDLE_NEED_WRITE(5 + length);  // fifo is not ready for reply
+		fifo_skip(softio->rx, 6);  // really get head and xlength
+		__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_READ_MULTI, length);
+		sum=0; for (uint32_t i=0; i<xlength; ++i) {  // each region as a separate read, so before could redirect its address as well
+			__softio_head_deque(softio->rx, &region);
+			length = region.length;  // but not its length, which is already in the reply
+			__softio_before(softio, &region);
+			sum += __softio_sum(softio->base + region.addr, length);
+			fifo_copy_from_buffer(softio->tx, softio->base + region.addr, length);
+			__softio_after(softio, &region);
+		}
+		fifo_enque(softio->tx, -sum);
+		fifo_skip(softio->rx, 1);  // get checksum outside
+		break;
+	default:
+		SOFTIO_CHECK(0, "invalid extended request");
+	}
+	++softio->handled;
+	return 0;
+}
+
+// rptr could be NULL, in which case the respond is simply discarded
+static inline int __softio_try_handle_extend_ret(SoftIO_t* softio, SoftIO_Trans_t* rptr) {
+	SOFTIO_HANDLE_NEED_READ(4);  // opcode and xlength not ready
+	uint32_t op = (unsigned char)fifo_preread(softio->rx, 1);
+	uint32_t xlength = __softio_preread_u16(softio->rx, 2);
+	uint32_t length;
+	char sum;
+	SOFTIO_CHECK_RET((!rptr || op == rptr->head.length), "ret and request must be the same opcode");
+	SOFTIO_CHECK_RET((!rptr || xlength == rptr->xlength || op == SOFTIO_EXT_RUN), "extended transaction length not equal");
+	switch (op) {
+	case SOFTIO_EXT_READ:
+		SOFTIO_HANDLE_NEED_READ(4 + xlength + 1);  // data not ready
+		sum = __softio_fifo_sum(softio->rx, 4, xlength + 1);
+		SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+		fifo_skip(softio->rx, 4);  // get type, opcode and xlength
+		if (rptr) {
+			fifo_move_to_buffer(softio->base + rptr->head.addr, softio->rx, xlength);
+			__softio_shadow_update(softio, rptr->head.addr, xlength);
+		} else fifo_skip(softio->rx, xlength);
+		fifo_skip(softio->rx, 1); // get checksum out of fifo
+		break;
+	case SOFTIO_EXT_WRITE:
+	case SOFTIO_EXT_FENCE:
+		fifo_skip(softio->rx, 4);  // get type, opcode and xlength
+		break;
+	case SOFTIO_EXT_SUBSCRIBE:
+		fifo_skip(softio->rx, 4);  // get type, opcode and xlength
+		if (rptr && xlength == 0) softio->subs[rptr->xcount].length = 0;  // no more push after the reply
+		break;
+	case SOFTIO_EXT_CREDIT:
+		SOFTIO_HANDLE_NEED_READ(6);  // capacity not ready
+		length = __softio_preread_u16(softio->rx, 4);
+		fifo_skip(softio->rx, 6);
+		if (rptr) {
+			softio->credit_capacity = length;
+			softio->credit_acked = 6;  // remote has consumed exactly the request when replying
+		}
+		break;
+	case SOFTIO_EXT_ATOMIC:
+		SOFTIO_HANDLE_NEED_READ(4 + 2 * xlength + 1);  // data not ready
+		sum = __softio_fifo_sum(softio->rx, 4, 2 * xlength + 1);
+		SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+		fifo_skip(softio->rx, 4);  // get type, opcode and xlength
+		if (rptr) {
+			length = 0;
+			fifo_move_to_buffer((char*)(void*)&length, softio->rx, xlength);  // little endian
+			if (rptr->result) *rptr->result = length;
+			fifo_move_to_buffer(softio->base + rptr->head.addr, softio->rx, xlength);  // new value
+			__softio_shadow_update(softio, rptr->head.addr, xlength);
+		} else fifo_skip(softio->rx, 2 * xlength);
+		fifo_skip(softio->rx, 1); // get checksum out of fifo
+		break;
+	case SOFTIO_EXT_RUN:
+		SOFTIO_CHECK_RET(5 + xlength <= fifo_capacity(softio->rx), "reply larger than rx fifo");
+		SOFTIO_HANDLE_NEED_READ(4 + xlength + 1);  // data not ready
+		sum = __softio_fifo_sum(softio->rx, 4, xlength + 1);
+		SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+		fifo_skip(softio->rx, 4);  // get type, opcode and xlength
+		if (rptr) __softio_prog_scatter(softio, rptr, xlength);
+		else fifo_skip(softio->rx, xlength);
+		fifo_skip(softio->rx, 1); // get checksum out of fifo
+		break;
+	case SOFTIO_EXT_READ_MULTI:
+		SOFTIO_HANDLE_NEED_READ(4 + xlength + 1);  // data not ready
+		sum = __softio_fifo_sum(softio->rx, 4, xlength + 1);
+		SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+		fifo_skip(softio->rx, 4);  // get type, opcode and xlength
+		if (rptr) for (uint32_t i=0; i<rptr->xcount; ++i) {  // scatter into regions
+			SoftIO_Head_t* region = softio->regions + softio->region_read;
+			fifo_move_to_buffer(softio->base + region->addr, softio->rx, region->length);
+			__softio_shadow_update(softio, region->addr, region->length);
+			softio->region_read = (softio->region_read + 1) % SOFTIO_REGION_LENGTH;
+		} else fifo_skip(softio->rx, xlength);
+		fifo_skip(softio->rx, 1); // get checksum out of fifo
+		break;
+	default:
+		SOFTIO_CHECK_RET(0, "invalid extended respond");
+	}
+	return 0;
+}
+
+// frames pushed by slave, see SOFTIO_EXT_IS_PUSH
+static inline int __softio_try_handle_push(SoftIO_t* softio) {
+	SOFTIO_HANDLE_NEED_READ(4);  // opcode and xlength not ready
+	uint32_t op = (unsigned char)fifo_preread(softio->rx, 1);
+	uint32_t xlength = __softio_preread_u16(softio->rx, 2);
+	uint32_t id;
+	char sum;
+	SoftIO_Sub_t* sub;
+	switch (op) {
+	case SOFTIO_EXT_CREDIT_REPORT:
+		fifo_skip(softio->rx, 4);
+		softio->credit_acked = xlength;
+		break;
+	case SOFTIO_EXT_PUSH:
+		SOFTIO_CHECK_RET(6 + xlength <= fifo_capacity(softio->rx), "push larger than rx fifo");
+		SOFTIO_HANDLE_NEED_READ(4 + 1 + xlength + 1);  // data not ready
+		sum = __softio_fifo_sum(softio->rx, 5, xlength + 1);
+		SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+		id = (unsigned char)fifo_preread(softio->rx, 4);
+		SOFTIO_CHECK_RET(id < SOFTIO_SUB_LENGTH, "invalid subscription id");
+		sub = softio->subs + id;
+		fifo_skip(softio->rx, 5);  // get type, opcode, xlength and id
+		if (!sub->length || ((sub->flags & SOFTIO_SUB_FIFO) ? xlength > sub->length : xlength != sub->length)) {  // not subscribed by this host
+			fifo_skip(softio->rx, xlength + 1);
+			break;
+		}
+		if (sub->flags & SOFTIO_SUB_FIFO) {
+			Fifo_t* fptr = (Fifo_t*)(softio->base + sub->addr);
+			assert(xlength <= fifo_remain(fptr) && "local fifo is not enough to read");
+			__softio_fifo_move_sum(fptr, softio->rx, xlength);
+		} else {
+			fifo_move_to_buffer(softio->base + sub->addr, softio->rx, xlength);
+			__softio_shadow_update(softio, sub->addr, xlength);
+		}
+		fifo_skip(softio->rx, 1); // get checksum out of fifo
+		if (sub->callback) sub->callback(softio, id);
+		break;
+	case SOFTIO_EXT_ERROR_REPORT:
+		fifo_skip(softio->rx, 4);
+		if (!softio->resync) return __softio_error(softio, SOFTIO_RESYNC_REPLY, "remote found a corrupt frame");  // remote is discarding requests until SOFTIO_EXT_SYNC
+		break;
+	default:
+		SOFTIO_CHECK_RET(0, "invalid push frame");
+	}
+	return 0;
+}
+
+// (host) bytes of the request of a transaction sent again by resync, 0 if it cannot be built from the transaction and local memory
+static inline uint32_t __softio_replay_size(SoftIO_Trans_t* tptr) {
+	switch (tptr->head.type) {
+	case SOFTIO_HEAD_TYPE_READ:
+	case SOFTIO_HEAD_TYPE_READ_FIFO:
+	case SOFTIO_HEAD_TYPE_CLEAR_FIFO:
+	case SOFTIO_HEAD_TYPE_RESET_FIFO:
+		return 4;
+	case SOFTIO_HEAD_TYPE_WRITE:
+		return 4 + tptr->head.length + 1;
+	case SOFTIO_HEAD_TYPE_EXTEND:
+		if (tptr->head.length == SOFTIO_EXT_READ || tptr->head.length == SOFTIO_EXT_FENCE || tptr->head.length == SOFTIO_EXT_RUN) return 6;
+		if (tptr->head.length == SOFTIO_EXT_WRITE) return 6 + tptr->xlength + 1;
+	}
+	return 0;  // data of write fifo is gone from local fifo, and operands of atomic or regions of multi read are not kept
+}
+// (host) remote has handled `handled` requests before SOFTIO_EXT_SYNC, and discarded the rest. the window is compacted in order:
+//   transactions not handled are kept to be sent again by __softio_settle, as well as reads whose reply was discarded.
+//   others are dropped, and counted as lost if they're not handled or their reply has data
+static inline void __softio_resynced(SoftIO_t* softio, uint16_t handled) {
+	uint16_t discarded = softio->issued - handled;  // what remains is posted writes
+	uint32_t count = (softio->write - softio->read + softio->length) % softio->length, kept = 0, regions = 0;
+	for (uint32_t k=0; k<count; ++k) {
+		SoftIO_Trans_t* tptr = softio->transactions + (softio->read + k) % softio->length;
+		uint32_t type = tptr->head.type, op = tptr->head.length;
+		char sent = k < count - softio->replay;  // the last ones may be kept by the previous resync and not sent yet
+		char done = sent && (int16_t)(tptr->seq - handled) < 0;
+		char again;
+		if (type == SOFTIO_HEAD_TYPE_EXTEND && op == SOFTIO_EXT_READ_MULTI) regions += tptr->xcount;
+		if (sent && !done) --discarded;
+		if (done) {
+			again = type == SOFTIO_HEAD_TYPE_READ || (type == SOFTIO_HEAD_TYPE_EXTEND && op == SOFTIO_EXT_READ);
+			if (type == SOFTIO_HEAD_TYPE_EXTEND && op == SOFTIO_EXT_SUBSCRIBE && tptr->xlength == 0) softio->subs[tptr->xcount].length = 0;
+			if (type == SOFTIO_HEAD_TYPE_READ_FIFO || (type == SOFTIO_HEAD_TYPE_EXTEND && (op == SOFTIO_EXT_READ_MULTI ||
+				op == SOFTIO_EXT_CREDIT || op == SOFTIO_EXT_RUN || op == SOFTIO_EXT_ATOMIC))) ++softio->lost;
+		} else {
+			again = __softio_replay_size(tptr) != 0;
+			if (!again) ++softio->lost;
+		}
+		if (again) softio->transactions[(softio->read + kept++) % softio->length] = *tptr;
+	}
+	softio->lost += discarded;
+	softio->write = (softio->read + kept) % softio->length;
+	softio->replay = kept;
+	// multi reads are never kept, so their regions are freed. regions after them may be staged by __softio_delay_read_multi, which waits here
+	softio->region_read = (softio->region_read + regions) % SOFTIO_REGION_LENGTH;
+	softio->issued = handled;
+	softio->tag_replay = softio->tags;  // remote has dropped all deferred ones
+	if (softio->credit_capacity) {  // remote restarts counting from SOFTIO_EXT_SYNC, see __softio_sync
+		softio->credit_sent = softio->credit_sent - softio->sync_sent + 6;
+		softio->credit_acked = 6;
+	}
+}
+static inline int __softio_try_handle_sync_ret(SoftIO_t* softio) {
+	SOFTIO_HANDLE_NEED_READ(4 + 2 + 1);  // handled and checksum not ready
+	char sum = __softio_fifo_sum(softio->rx, 4, 2 + 1);
+	SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+	uint32_t id = __softio_preread_u16(softio->rx, 2);
+	uint32_t handled = __softio_preread_u16(softio->rx, 4);
+	fifo_skip(softio->rx, 4 + 2 + 1);
+	if (id == softio->sync_id) __softio_resynced(softio, handled);  // otherwise it's the reply of a SOFTIO_EXT_SYNC sent before
+	return 0;
+}
+// (host) reply of a tagged read, in any order with other replies
+static inline int __softio_try_handle_tagged_ret(SoftIO_t* softio) {
+	SOFTIO_HANDLE_NEED_READ(4 + 1);  // xlength and tag not ready
+	uint32_t length = __softio_preread_u16(softio->rx, 2);
+	uint32_t tag = (unsigned char)fifo_preread(softio->rx, 4);
+	SOFTIO_CHECK_RET(tag < SOFTIO_TAG_LENGTH && (softio->tags & ~softio->tag_replay & (1u << tag)), "tagged reply without request");
+	SoftIO_Head_t* rptr = softio->tagged + tag;
+	SOFTIO_CHECK_RET(length == rptr->length, "tagged read length not equal");
+	SOFTIO_HANDLE_NEED_READ(4 + 1 + length + 1);  // data not ready
+	char sum = __softio_fifo_sum(softio->rx, 4, 1 + length + 1);  // including tag and checksum
+	SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+	fifo_skip(softio->rx, 4 + 1);  // get type, opcode, xlength and tag
+	fifo_move_to_buffer(softio->base + rptr->addr, softio->rx, length);
+	__softio_shadow_update(softio, rptr->addr, length);
+	fifo_skip(softio->rx, 1); // get checksum out of fifo
+	softio->tags &= ~(1u << tag);
+	if (softio->callback) softio->callback(softio, rptr);
+	return 0;
+}
+
+static inline int __softio_try_handle_frame(SoftIO_t* softio) {
+	int need;
+	if (softio->resync && (need = __softio_resync_scan(softio))) return need;
 	if (fifo_empty(softio->rx)) return 1; // no message in, just need 1 byte
 	uint32_t type = 0x0F & fifo_preread(softio->rx, 0);
 	uint32_t length;
 	SoftIO_Head_t head;
 	Fifo_t* fptr;
 	char sum;
+	char ret[2];
 	// printf("type: %u\n", type);
 	if (SOFTIO_HEAD_TYPE_IS_RET(type)) {  // respond
+		if (type == (SOFTIO_HEAD_TYPE_EXTEND | 0x01)) {  // pushed frames have no transaction
+			SOFTIO_HANDLE_NEED_READ(2);  // opcode not ready
+			if (SOFTIO_EXT_IS_PUSH((unsigned char)fifo_preread(softio->rx, 1))) return __softio_try_handle_push(softio);
+			if ((unsigned char)fifo_preread(softio->rx, 1) == SOFTIO_EXT_SYNC) return __softio_try_handle_sync_ret(softio);  // not in window
+			if ((unsigned char)fifo_preread(softio->rx, 1) == SOFTIO_EXT_READ_TAGGED) return __softio_try_handle_tagged_ret(softio);
+		}
 #ifdef NOT_HANDLE_RESPOND
 		switch (type & 0x0E) {
 		case SOFTIO_HEAD_TYPE_READ:
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
 			length = (unsigned char)fifo_preread(softio->rx, 1);
 			SOFTIO_HANDLE_NEED_READ(length + 3);  // data not ready
-			for (uint32_t i=0; i<length+3; ++i) fifo_deque(softio->rx);
+			fifo_skip(softio->rx, length + 3);
 			break;
 		case SOFTIO_HEAD_TYPE_WRITE:
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
@@ -187,7 +1235,7 @@ static inline int __softio_try_handle_one(SoftIO_t* softio) {
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
 			length = (unsigned char)fifo_preread(softio->rx, 1);
 			SOFTIO_HANDLE_NEED_READ(length + 3);  // data not ready
-			for (uint32_t i=0; i<length+3; ++i) fifo_deque(softio->rx);
+			fifo_skip(softio->rx, length + 3);
 			break;
 		case SOFTIO_HEAD_TYPE_WRITE_FIFO:
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
@@ -199,60 +1247,70 @@ static inline int __softio_try_handle_one(SoftIO_t* softio) {
 			SOFTIO_HANDLE_NEED_READ(1);  // length not ready
 			fifo_deque(softio->rx);  // get type out
 			break;
+		case SOFTIO_HEAD_TYPE_EXTEND:
+			need = __softio_try_handle_extend_ret(softio, NULL);
+			if (need) return need;
+			break;
 		default:
-			assert(0 && "invalid respond");
+			SOFTIO_CHECK_RET(0, "invalid respond");
 		}
 #else
-		assert(softio->read != softio->write && "transaction empty but receive respond");
-		SoftIO_Head_t* rptr = softio->transactions + softio->read;
-		assert(SOFTIO_HEAD_TYPE_RAW(type) == rptr->type && "ret and request must be the same type");
+		SOFTIO_CHECK_RET(softio->read != softio->write, "transaction empty but receive respond");
+		SoftIO_Trans_t* tptr = softio->transactions + softio->read;
+		SoftIO_Head_t* rptr = &tptr->head;
+		SOFTIO_CHECK_RET(SOFTIO_HEAD_TYPE_RAW(type) == rptr->type, "ret and request must be the same type");
 		switch (rptr->type) {
 		case SOFTIO_HEAD_TYPE_READ:
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
 			length = (unsigned char)fifo_preread(softio->rx, 1);
 			// printf("length = %u, rptr->length = %u\n", length, rptr->length);
-			assert(length == rptr->length && "read transaction length not equal");
+			SOFTIO_CHECK_RET(length == rptr->length, "read transaction length not equal");
 			SOFTIO_HANDLE_NEED_READ(length + 3);  // data not ready
 			// then data is ready! compute the checksum and write data into local memory
-			sum = fifo_preread(softio->rx, 2+length);
-			for (uint32_t i=0; i<length; ++i) sum += fifo_preread(softio->rx, 2+i);
-			assert(sum == 0 && "checksum is non-zero");
-			fifo_deque(softio->rx); fifo_deque(softio->rx);  // get type and length
-			for (uint32_t i=0; i<length; ++i) softio->base[rptr->addr + i] = fifo_deque(softio->rx);
-			fifo_deque(softio->rx); // get checksum out of fifo
+			sum = __softio_fifo_sum(softio->rx, 2, length + 1);
+			SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+			fifo_skip(softio->rx, 2);  // get type and length
+			fifo_move_to_buffer(softio->base + rptr->addr, softio->rx, length);
+			__softio_shadow_update(softio, rptr->addr, length);
+			fifo_skip(softio->rx, 1); // get checksum out of fifo
 			break;
 		case SOFTIO_HEAD_TYPE_WRITE:
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
 			fifo_deque(softio->rx);  // get type out
 			length = (unsigned char)fifo_deque(softio->rx);
 			// printf("length = %u, rptr->length = %u\n", length, rptr->length);
-			assert(length == rptr->length && "write transaction length not equal");
+			SOFTIO_CHECK_RET(length == rptr->length, "write transaction length not equal");
 			break;
 		case SOFTIO_HEAD_TYPE_READ_FIFO:
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
 			length = (unsigned char)fifo_preread(softio->rx, 1);
-			assert(length <= rptr->length && "read fifo transaction length greater");
+			SOFTIO_CHECK_RET(length <= rptr->length, "read fifo transaction length greater");
 			SOFTIO_HANDLE_NEED_READ(length + 3);  // data not ready
-			sum = fifo_preread(softio->rx, 2+length);
-			for (uint32_t i=0; i<length; ++i) sum += fifo_preread(softio->rx, 2+i);
-			assert(sum == 0 && "checksum is non-zero");
-			fifo_deque(softio->rx); fifo_deque(softio->rx);  // get type and length
-			for (uint32_t i=0; i<length; ++i) fifo_enque((Fifo_t*)(softio->base + rptr->addr), fifo_deque(softio->rx));
-			fifo_deque(softio->rx); // get checksum out of fifo
+			sum = __softio_fifo_sum(softio->rx, 2, length + 1);
+			SOFTIO_CHECK_RET(sum == 0, "checksum is non-zero");
+			fifo_skip(softio->rx, 2);  // get type and length
+			fptr = (Fifo_t*)(softio->base + rptr->addr);
+			assert(length <= fifo_remain(fptr) && "local fifo is not enough to read");
+			__softio_fifo_move_sum(fptr, softio->rx, length);
+			fifo_skip(softio->rx, 1); // get checksum out of fifo
 			break;
 		case SOFTIO_HEAD_TYPE_WRITE_FIFO:
 			SOFTIO_HANDLE_NEED_READ(2);  // length not ready
 			fifo_deque(softio->rx);  // get type out
 			length = (unsigned char)fifo_deque(softio->rx);
-			assert(length == rptr->length && "write transaction length not equal");
+			SOFTIO_CHECK_RET(length == rptr->length, "write transaction length not equal");
 			break;
 		case SOFTIO_HEAD_TYPE_CLEAR_FIFO:
 		case SOFTIO_HEAD_TYPE_RESET_FIFO:
 			SOFTIO_HANDLE_NEED_READ(1);  // length not ready
 			fifo_deque(softio->rx);  // get type out
 			break;
+		case SOFTIO_HEAD_TYPE_EXTEND:
+			need = __softio_try_handle_extend_ret(softio, tptr);
+			if (need || softio->resync) return need;  // a corrupt reply is discarded, the transaction is left to resync
+			break;
 		default:
-			assert(0 && "invalid respond");
+			SOFTIO_CHECK_RET(0, "invalid respond");
 		}
 		if (softio->callback) softio->callback(softio, rptr);
 		softio->read = (softio->read + 1) % softio->length;  // delete this transaction
@@ -262,89 +1320,78 @@ static inline int __softio_try_handle_one(SoftIO_t* softio) {
 		case SOFTIO_HEAD_TYPE_READ:
 			SOFTIO_HANDLE_NEED_READ(4);  // length not ready
 			__softio_head_preread(softio->rx, &head);  // do not get the head, simply because space may not available now
-			assert(head.length != 0 && head.length != 255 && "invalid length");
-			assert((uint32_t)(head.addr + head.length) <= softio->size && "read outside shared space");
+			SOFTIO_CHECK(head.length != 0 && head.length != 255, "invalid length");
+			SOFTIO_CHECK((uint32_t)(head.addr + head.length) <= softio->size, "read outside shared space");
 			SOFTIO_HANDLE_NEED_WRITE((uint32_t)(3 + head.length));  // fifo is not ready for reply
 			__softio_head_deque(softio->rx, &head);  // really get head
-			if (softio->before) softio->before(softio, &head);
-			fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_READ | 0x01));
-			fifo_enque(softio->tx, head.length);
-			sum=0; for (uint32_t i=0; i<head.length; ++i) {
-				sum += softio->base[head.addr + i];
-				fifo_enque(softio->tx, softio->base[head.addr + i]);
-			}
-			fifo_enque(softio->tx, -sum);
+			__softio_before(softio, &head);
+			ret[0] = (SOFTIO_HEAD_TYPE_READ | 0x01); ret[1] = head.length;
+			fifo_copy_from_buffer(softio->tx, ret, 2);
+			__softio_enque_sum(softio->tx, softio->base + head.addr, head.length);
 			break;
 		case SOFTIO_HEAD_TYPE_WRITE:
 			SOFTIO_HANDLE_NEED_READ(4);  // length not ready
 			__softio_head_preread(softio->rx, &head);  // do not get the head, simply because data may not available now
-			assert(head.length != 0 && head.length != 255 && "invalid length");
-			assert((uint32_t)(head.addr + head.length) <= softio->size && "write outside shared space");
+			SOFTIO_CHECK(head.length != 0 && head.length != 255, "invalid length");
+			SOFTIO_CHECK((uint32_t)(head.addr + head.length) <= softio->size, "write outside shared space");
 			SOFTIO_HANDLE_NEED_READ((uint32_t)(4 + head.length + 1));  // data not ready
 			SOFTIO_HANDLE_NEED_WRITE(2);  // fifo is not ready for reply
+			sum = __softio_fifo_sum(softio->rx, 4, head.length + 1);  // including checksum
+			SOFTIO_CHECK(sum == 0, "check sum failed for write");
 			__softio_head_deque(softio->rx, &head);  // really get head
-			if (softio->before) softio->before(softio, &head);
-			sum=0; for (uint32_t i=0; i<(uint32_t)(head.length + 1); ++i) {  // including checksum
-				sum += fifo_preread(softio->rx, i);
-			} assert(sum == 0 && "check sum failed for write");
-			for (uint32_t i=0; i<head.length; ++i) {  // actually write into local memory
-				softio->base[head.addr + i] = fifo_deque(softio->rx);
-			} fifo_deque(softio->rx);  // get checksum outside
-			fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_WRITE | 0x01));
-			fifo_enque(softio->tx, head.length);
+			__softio_before(softio, &head);
+			fifo_move_to_buffer(softio->base + head.addr, softio->rx, head.length);  // actually write into local memory
+			fifo_skip(softio->rx, 1);  // get checksum outside
+			ret[0] = (SOFTIO_HEAD_TYPE_WRITE | 0x01); ret[1] = head.length;
+			fifo_copy_from_buffer(softio->tx, ret, 2);
 			break;
 		case SOFTIO_HEAD_TYPE_READ_FIFO:
 			SOFTIO_HANDLE_NEED_READ(4);  // length not ready
 			__softio_head_preread(softio->rx, &head);  // do not get the head, simply because space may not available now
-			assert(head.length != 0 && head.length != 255 && "invalid length");
-			assert((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end && "read fifo outside valid space");
-			assert((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0 && "read fifo alignment error");
+			SOFTIO_CHECK(head.length != 0 && head.length != 255, "invalid length");
+			SOFTIO_CHECK((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end, "read fifo outside valid space");
+			SOFTIO_CHECK((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0, "read fifo alignment error");
 			fptr = (Fifo_t*)(softio->base + head.addr);
-			length = head.length;
-			if (fifo_count(fptr) < length) length = fifo_count(fptr);  // only have these
+			length = fifo_spsc_count(fptr);  // a snapshot, producer may add more meanwhile
+			if (length > head.length) length = head.length;
 			SOFTIO_HANDLE_NEED_WRITE((uint32_t)(3 + length));  // fifo is not ready for reply
 			__softio_head_deque(softio->rx, &head);  // really get head
-			if (softio->before) softio->before(softio, &head);
-			fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_READ_FIFO | 0x01));
-			fifo_enque(softio->tx, length);
-			sum=0; for (uint32_t i=0; i<length; ++i) {
-				char a = fifo_deque(fptr); sum += a;
-				fifo_enque(softio->tx, a);
-			}
+			__softio_before(softio, &head);
+			ret[0] = (SOFTIO_HEAD_TYPE_READ_FIFO | 0x01); ret[1] = length;
+			fifo_copy_from_buffer(softio->tx, ret, 2);
+			sum = __softio_fifo_move_sum(softio->tx, fptr, length);
 			fifo_enque(softio->tx, -sum);
 			break;
 		case SOFTIO_HEAD_TYPE_WRITE_FIFO:
 			SOFTIO_HANDLE_NEED_READ(4);  // length not ready
 			__softio_head_preread(softio->rx, &head);  // do not get the head, simply because space may not available now
-			assert(head.length != 0 && head.length != 255 && "invalid length");
-			assert((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end && "write fifo outside valid space");
-			assert((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0 && "write fifo alignment error");
+			SOFTIO_CHECK(head.length != 0 && head.length != 255, "invalid length");
+			SOFTIO_CHECK((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end, "write fifo outside valid space");
+			SOFTIO_CHECK((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0, "write fifo alignment error");
 			SOFTIO_HANDLE_NEED_READ((uint32_t)(4 + head.length + 1));  // data not ready
 			SOFTIO_HANDLE_NEED_WRITE(2);  // fifo is not ready for reply
-			__softio_head_deque(softio->rx, &head);  // really get head
-			if (softio->before) softio->before(softio, &head);
-			sum=0; for (uint32_t i=0; i<(uint32_t)(head.length + 1); ++i) {  // including checksum
-				sum += fifo_preread(softio->rx, i);
-			} assert(sum == 0 && "check sum failed for write");
+			sum = __softio_fifo_sum(softio->rx, 4, head.length + 1);  // including checksum
+			SOFTIO_CHECK(sum == 0, "check sum failed for write");
 			fptr = (Fifo_t*)(softio->base + head.addr);
 			length = head.length;
-			assert(length <= fifo_remain(fptr) && "fifo is not enough to write");
-			for (uint32_t i=0; i<length; ++i) {  // actually write into local memory
-				fifo_enque(fptr, fifo_deque(softio->rx));
-			} for (uint32_t i=0; i<head.length - length; ++i) fifo_deque(softio->rx);  // get overflowed ones
-			fifo_deque(softio->rx);  // get checksum outside
-			fifo_enque(softio->tx, (SOFTIO_HEAD_TYPE_WRITE_FIFO | 0x01));
-			fifo_enque(softio->tx, length);
+			SOFTIO_CHECK(length <= fifo_remain(fptr), "fifo is not enough to write");
+			__softio_head_deque(softio->rx, &head);  // really get head
+			__softio_before(softio, &head);
+			__softio_fifo_move_sum(fptr, softio->rx, length);  // actually write into local memory
+			fifo_skip(softio->rx, head.length - length + 1);  // get overflowed ones and checksum outside
+			ret[0] = (SOFTIO_HEAD_TYPE_WRITE_FIFO | 0x01); ret[1] = length;
+			fifo_copy_from_buffer(softio->tx, ret, 2);
 			break;
 		case SOFTIO_HEAD_TYPE_CLEAR_FIFO:
 		case SOFTIO_HEAD_TYPE_RESET_FIFO:
 			SOFTIO_HANDLE_NEED_READ(4);  // length not ready
 			SOFTIO_HANDLE_NEED_WRITE(1);  // fifo is not ready for reply
+			__softio_head_preread(softio->rx, &head);
+			SOFTIO_CHECK(head.length == 0, "invalid length, must be 0");
+			SOFTIO_CHECK((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end, "write fifo outside valid space");
+			SOFTIO_CHECK((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0, "write fifo alignment error");
 			__softio_head_deque(softio->rx, &head);  // really get head
-			if (softio->before) softio->before(softio, &head);
-			assert(head.length == 0 && "invalid length, must be 0");
-			assert((uint32_t)head.addr >= softio->fifo_begin && (uint32_t)(head.addr + sizeof(Fifo_t)) <= softio->fifo_end && "write fifo outside valid space");
-			assert((head.addr - softio->fifo_begin) % sizeof(Fifo_t) == 0 && "write fifo alignment error");
+			__softio_before(softio, &head);
 			if (type == SOFTIO_HEAD_TYPE_CLEAR_FIFO) fifo_clear((Fifo_t*)(softio->base + head.addr));
 			else {
 				fptr = (Fifo_t*)(softio->base + head.addr);
@@ -352,59 +1399,194 @@ static inline int __softio_try_handle_one(SoftIO_t* softio) {
 			}
 			fifo_enque(softio->tx, (type | 0x01));
 			break;
+		case SOFTIO_HEAD_TYPE_EXTEND:
+			return __softio_try_handle_extend(softio);  // hooks are called inside
 		default:
-			assert(0 && "invalid request");
+			SOFTIO_CHECK(0, "invalid request");
 		}
-		if (softio->after) softio->after(softio, &head);
+		__softio_after(softio, &head);
+		++softio->handled;
 	}
 	return 0;
 }
+// handle one frame and count the bytes consumed from rx (including discarded ones), for credit flow control
+static inline int __softio_try_handle_one(SoftIO_t* softio) {
+	uint32_t read = softio->rx->read;
+	int need = __softio_try_handle_frame(softio);
+	softio->credit_consumed += __fifo_distance(softio->rx, read, softio->rx->read);
+	return need;
+}
 #define softio_try_handle_one(softio) __softio_try_handle_one(&(softio))
 
+// slave reports consumed bytes every quarter of rx, or when rx is drained so that host waiting for credits could continue
+static inline void __softio_credit_report(SoftIO_t* softio) {
+	if (!softio->credit_reporting || softio->credit_consumed == softio->credit_reported) return;
+	if ((uint16_t)(softio->credit_consumed - softio->credit_reported) < fifo_capacity(softio->rx) / 4 && !fifo_empty(softio->rx)) return;
+	if (fifo_remain(softio->tx) < 4) return;  // report next time
+	__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_CREDIT_REPORT, softio->credit_consumed);
+	softio->credit_reported = softio->credit_consumed;
+}
+
+// slave pushes subscriptions which are due, if tx has room. before/after are called as if host reads them
+static inline void __softio_push_subscriptions(SoftIO_t* softio) {
+	if (!softio->subscribed) return;
+	uint32_t now = softio->tick ? softio->tick() : 0;
+	for (uint32_t id=0; id<SOFTIO_SUB_LENGTH; ++id) {
+		SoftIO_Sub_t* sub = softio->subs + id;
+		if (!sub->length) continue;
+		char due = !(sub->flags & SOFTIO_SUB_PUSHED) || (uint32_t)(now - sub->last) >= sub->period;
+		if (sub->flags & SOFTIO_SUB_FIFO) {  // full pushes are sent as soon as possible, partial ones every period. never split a push
+			SoftIO_Head_t head;
+			Fifo_t* fptr = (Fifo_t*)(softio->base + sub->addr);
+			uint32_t length = fifo_spsc_count(fptr);
+			if (length > sub->length) length = sub->length;
+			if (length == 0 || (length < sub->length && !due) || fifo_remain(softio->tx) < 6 + length) continue;  // push next time
+			sub->last = now;
+			sub->flags |= SOFTIO_SUB_PUSHED;
+			head.type = SOFTIO_HEAD_TYPE_READ_FIFO; head.addr = sub->addr; head.length = length;
+			__softio_before(softio, &head);
+			__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_PUSH, length);
+			fifo_enque(softio->tx, id);
+			fifo_enque(softio->tx, -__softio_fifo_move_sum(softio->tx, fptr, length));
+			__softio_after(softio, &head);
+			continue;
+		}
+		if (!due || fifo_remain(softio->tx) < 6u + sub->length) continue;  // push next time
+		sub->last = now;
+		__softio_hook_pieces(softio, SOFTIO_HEAD_TYPE_READ, sub->addr, sub->length, 0);
+		uint32_t hash = 0;
+		if (sub->flags & SOFTIO_SUB_ON_CHANGE) hash = __softio_hash(softio->base + sub->addr, sub->length);
+		if (!(sub->flags & SOFTIO_SUB_ON_CHANGE) || !(sub->flags & SOFTIO_SUB_PUSHED) || hash != sub->hash) {
+			__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_PUSH, sub->length);
+			fifo_enque(softio->tx, id);
+			__softio_enque_sum(softio->tx, softio->base + sub->addr, sub->length);
+			sub->hash = hash;
+			sub->flags |= SOFTIO_SUB_PUSHED;
+		}
+		__softio_hook_pieces(softio, SOFTIO_HEAD_TYPE_READ, sub->addr, sub->length, 1);
+	}
+}
+
+// slave replies deferred tagged reads which are ready, if tx has room. hooks are called as usual, after `ready`
+static inline void __softio_complete_tagged(SoftIO_t* softio) {
+	for (uint32_t tag=0; tag<SOFTIO_TAG_LENGTH && (softio->deferred >> tag); ++tag) {
+		if (!(softio->deferred & (1u << tag))) continue;
+		SoftIO_Head_t* head = softio->tagged + tag;
+		if (fifo_remain(softio->tx) < 6u + head->length) return;  // reply next time
+		if (softio->ready && !softio->ready(softio, head)) continue;
+		__softio_before(softio, head);
+		__softio_extend_ret_enque(softio->tx, SOFTIO_EXT_READ_TAGGED, head->length);
+		fifo_enque(softio->tx, tag);
+		fifo_copy_from_buffer(softio->tx, softio->base + head->addr, head->length);
+		fifo_enque(softio->tx, -(char)(tag + __softio_sum(softio->base + head->addr, head->length)));
+		__softio_after(softio, head);
+		softio->deferred &= ~(1u << tag);
+	}
+}
+
+// a partial frame which doesn't grow for SOFTIO_STALL_TIMEOUT is corrupt (e.g., its length), otherwise both sides wait forever
+static inline void __softio_check_stall(SoftIO_t* softio, int need) {
+	if (!softio->tick || need <= 0 || fifo_empty(softio->rx) || softio->resync) {
+		softio->stall_count = 0;
+		return;
+	}
+	uint32_t now = softio->tick();
+	if (fifo_count(softio->rx) != softio->stall_count) {
+		softio->stall_count = fifo_count(softio->rx);
+		softio->stall_tick = now;
+	} else if ((uint32_t)(now - softio->stall_tick) >= SOFTIO_STALL_TIMEOUT) {
+		__softio_error(softio, SOFTIO_HEAD_TYPE_IS_REQUEST(fifo_preread(softio->rx, 0)) ? SOFTIO_RESYNC_REQUEST : SOFTIO_RESYNC_REPLY,
+			"partial frame timeout");
+		softio->stall_count = 0;
+	}
+}
+
 static inline void __softio_try_handle_all(SoftIO_t* softio) {
-	while (__softio_try_handle_one(softio) == 0);
+	int need;
+	while ((need = __softio_try_handle_one(softio)) == 0);
+	__softio_check_stall(softio, need);
+	if (softio->deferred) __softio_complete_tagged(softio);
+	__softio_credit_report(softio);
+	__softio_push_subscriptions(softio);
 }
 #define softio_try_handle_all(softio) __softio_try_handle_all(&(softio))
 
+// zero-copy input for slave: transport hands in a received buffer (e.g., a USB OUT packet), complete frames are handled in place
+//   and only a trailing partial frame (or frames waiting for tx space) is copied into rx. a frame already partial in rx is completed first.
+//   return bytes taken from buf, transport should keep the buffer and hand in the rest later (e.g., by not re-arming the endpoint)
+static inline uint32_t __softio_receive(SoftIO_t* softio, const char* buf, uint32_t length) {
+	uint32_t taken = 0;
+	int need = 0;
+	while (!fifo_empty(softio->rx) && taken < length) {  // rx goes first to keep the order
+		need = __softio_try_handle_one(softio);
+		if (need < 0) break;  // tx is full, stage the rest
+		if (need == 0) continue;
+		uint32_t more = need - fifo_count(softio->rx);
+		if (more > length - taken) more = length - taken;
+		more = fifo_copy_from_buffer(softio->rx, buf + taken, more);
+		if (more == 0) break;
+		taken += more;
+	}
+	Fifo_t view;
+	if (fifo_empty(softio->rx) && taken < length && fifo_in_reach(&view, buf)) {
+		// a view of buf holding at most what rx could, with the capacity of rx so that size checks and credit keep their meaning.
+		// it never wraps since write < length, and a frame not complete in it is left to rx
+		uint32_t count = length - taken;
+		if (count > fifo_capacity(softio->rx)) count = fifo_capacity(softio->rx);
+		fifo_init(&view, (char*)buf + taken, fifo_capacity(softio->rx) + 1);
+		view.write = count;
+		Fifo_t* rx = softio->rx;
+		softio->rx = &view;
+		while (!fifo_empty(&view) && __softio_try_handle_one(softio) == 0);
+		softio->rx = rx;
+		taken += view.read;
+	}
+	return taken + fifo_copy_from_buffer(softio->rx, buf + taken, length - taken);
+}
+#define softio_receive(softio, buf, length) __softio_receive(&(softio), buf, length)
+
 static inline void __softio_gets_fifo_blocking(SoftIO_t* softio, Fifo_t* fifo, size_t size) {  // wait for fifo_count > size
-	assert(__FIFO_GET_LENGTH(fifo) > size);
+	assert(fifo_capacity(fifo) >= size);
 	if (!softio->gets) { while (fifo_count(fifo) < size) if (softio->yield) softio->yield(); }
 	else {  // use gets function to get bytes, note that fifo may not be continuous so just do it
 		while (fifo_count(fifo) < size) {  // always try
-			size_t length = size - fifo_count(fifo);
-			if (length > __fifo_write_base_length(fifo)) length = __fifo_write_base_length(fifo);
-			size_t ret = softio->gets(__fifo_write_base(fifo), length);
-			fifo->write = (fifo->write + ret) % __FIFO_GET_LENGTH(fifo);
+			Fifo_Spans_t spans;
+			fifo_write_spans(fifo, &spans, size - fifo_count(fifo));
+			size_t ret = softio->gets(spans.ptr[0], spans.len[0]);
+			fifo_write_commit(fifo, ret);
+			if (ret == 0 && fifo == softio->rx && (softio->features & SOFTIO_FEATURE_RESYNC) && (softio->resync || softio->read != softio->write ||
+					(softio->credit_capacity && softio->credit_sent != softio->credit_acked))) {
+				softio->error = "timeout";  // of gets. a frame, a credit report or SOFTIO_EXT_SYNC is lost, so resync (again)
+				++softio->errors;
+				__softio_sync(softio);
+				return;  // frame handling decides what it needs then
+			}
 		}
 	}
 }
-#define softio_flush_fifo(softio, fifo) __softio_puts_fifo_blocking(&(softio), &(fifo), __FIFO_GET_LENGTH(&(fifo)) - 1)
+#define softio_flush_fifo(softio, fifo) __softio_puts_fifo_blocking(&(softio), &(fifo), fifo_capacity(&(fifo)))
 #define softio_flush(softio) do { \
 	softio_flush_fifo(softio, (*(softio).tx)); \
 	if ((softio).available) { \
 		unsigned int wait_cnt = (softio).available() + fifo_count((softio).rx); \
-		if (wait_cnt >= __FIFO_GET_LENGTH(((softio).rx))) wait_cnt = __FIFO_GET_LENGTH(((softio).rx)) - 2; \
+		if (wait_cnt > fifo_capacity((softio).rx)) wait_cnt = fifo_capacity((softio).rx) - 1; \
 		__softio_gets_fifo_blocking(&(softio), (softio).rx, wait_cnt); \
 	} \
 } while(0)
 static inline void __softio_puts_fifo_blocking(SoftIO_t* softio, Fifo_t* fifo, size_t size) {  // wait for fifo_remain > size
-	assert(__FIFO_GET_LENGTH(fifo) > size);
+	assert(fifo_capacity(fifo) >= size);
 	if (!softio->puts) { while (fifo_count(fifo) < size) if (softio->yield) softio->yield(); }
 	else {  // use puts function to put bytes
 		while (fifo_remain(fifo) < size) {  // always try
-			size_t length = size - fifo_remain(fifo);
-			if (length > __fifo_read_base_length(fifo)) length = __fifo_read_base_length(fifo);
-			size_t ret = softio->puts(__fifo_read_base(fifo), length);
-			fifo->read = (fifo->read + ret) % __FIFO_GET_LENGTH(fifo);
+			Fifo_Spans_t spans;
+			fifo_read_spans(fifo, &spans, size - fifo_remain(fifo));
+			size_t ret = softio->puts(spans.ptr[0], spans.len[0]);
+			fifo_read_commit(fifo, ret);
 		}
 	}
 }
-static inline void __softio_wait_one(SoftIO_t* softio) {
-	// first flush it
-	softio_flush(*softio);
-	if (fifo_empty(softio->rx) && softio->read != softio->write) {  // need respond
-		__softio_gets_fifo_blocking(softio, softio->rx, 1);  // get 1 byte to process
-	}
+// block until one frame is handled, either a respond or a pushed one
+static inline void __softio_wait_frame(SoftIO_t* softio) {
 	int need = __softio_try_handle_one(softio);
 	while (need != 0) {
 		if (need > 0) {  // need to read
@@ -415,17 +1597,81 @@ static inline void __softio_wait_one(SoftIO_t* softio) {
 		need = __softio_try_handle_one(softio);  // retry it
 	}
 }
+static inline void __softio_settle(SoftIO_t* softio);
+static inline void __softio_wait_one(SoftIO_t* softio) {
+	__softio_settle(softio);
+	// first flush it
+	softio_flush(*softio);
+	if (softio->read == softio->write) return;  // nothing to wait, e.g., only posted writes are sent
+	uint16_t read = softio->read;
+	while (softio->read == read && softio->read != softio->write) {  // resync may drop it
+		__softio_wait_frame(softio);  // pushed frames may come before the respond
+		if (softio->resync || softio->replay) {
+			__softio_settle(softio);
+			softio_flush(*softio);
+		}
+	}
+}
 #define softio_wait_one(softio) __softio_wait_one(&(softio))
+// block until a frame from remote is handled, e.g., a pushed one
+#define softio_wait_frame(softio) do { softio_flush(softio); __softio_wait_frame(&(softio)); } while (0)
+// block until replies of tags in mask are handled
+static inline void __softio_wait_tags(SoftIO_t* softio, uint32_t mask) {
+	while (softio->tags & mask) {
+		__softio_settle(softio);
+		softio_flush(*softio);
+		if (softio->tags & mask) __softio_wait_frame(softio);
+	}
+}
+#define softio_wait_tag(softio, tag) do { \
+	if ((tag) == SOFTIO_TAG_NONE) softio_wait_all(softio); \
+	else __softio_wait_tags(&(softio), 1u << (tag)); \
+} while (0)
 #define softio_wait_all(softio) do { \
 	while ((softio).read != (softio).write) softio_wait_one(softio); \
+	if ((softio).tags) __softio_wait_tags(&(softio), (softio).tags); \
 } while (0)
 
+// wait until a frame of n bytes could be put into tx: local tx has space, and remote rx has credits if credit flow control is enabled.
+//   the frame is counted as sent once it's in local tx
+static inline char __softio_tx_ready(SoftIO_t* softio, uint32_t n) {
+	if (fifo_remain(softio->tx) < n) return 0;
+	return !softio->credit_capacity || (uint16_t)(softio->credit_sent - softio->credit_acked) + n <= softio->credit_capacity;
+}
+static inline void __softio_tx_reserve(SoftIO_t* softio, uint32_t n) {
+	assert((!softio->credit_capacity || n <= softio->credit_capacity) && "frame larger than remote rx");
+	__softio_settle(softio);
+	while (!__softio_tx_ready(softio, n)) {
+		if (softio->read != softio->write) __softio_wait_one(softio);
+		else {  // only posted writes are in flight
+			softio_flush(*softio);
+			if (!__softio_tx_ready(softio, n)) __softio_wait_frame(softio);  // remote reports credits when its rx is drained
+		}
+		__softio_settle(softio);  // resync may happen while waiting
+	}
+	softio->credit_sent += n;
+	softio->transactions[softio->write].seq = softio->issued++;  // for posted writes, it's the empty slot of window
+	softio->transactions[softio->write].context = NULL;
+}
+
+// use a user provided window instead of the SOFTIO_HEAD_LENGTH one, length-1 transactions could be pending.
+//   with credit flow control, a deep window is safe since remote rx never overflows
+static inline void __softio_set_window(SoftIO_t* softio, SoftIO_Trans_t* transactions, uint16_t length) {
+	assert(softio->read == softio->write && "cannot change window with pending transactions");
+	assert(length >= 2 && "window too small");
+	softio->transactions = transactions;
+	softio->length = length;
+	softio->read = 0;
+	softio->write = 0;
+}
+#define softio_set_window(softio, transactions, length) __softio_set_window(&(softio), transactions, length)
+
 static inline void __softio_delay_read_no_check(SoftIO_t* softio, uint32_t addr, uint32_t length) {
 #ifndef NOT_HANDLE_RESPOND
 	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
-	while (fifo_remain(softio->tx) < 4) __softio_wait_one(softio);  // sending queue is full, wait
+	__softio_tx_reserve(softio, 4);  // sending queue or remote rx is full, wait
 #endif
-	SoftIO_Head_t* tptr = softio->transactions + softio->write;
+	SoftIO_Head_t* tptr = &softio->transactions[softio->write].head;
 	tptr->type = SOFTIO_HEAD_TYPE_READ;
 	tptr->addr = addr;
 	tptr->length = length;
@@ -435,25 +1681,234 @@ static inline void __softio_delay_read_no_check(SoftIO_t* softio, uint32_t addr,
 #endif
 	__softio_head_enque(softio->tx, tptr);
 }
+// maximum length of one read/write transaction. extended ones are limited by fifo length, assuming remote has the same fifo as local
+static inline uint32_t __softio_max_length(SoftIO_t* softio) {
+	if (!(softio->features & SOFTIO_FEATURE_EXTEND)) return 254;
+	uint32_t length = __fifo_size(softio->rx) < __fifo_size(softio->tx) ? __fifo_size(softio->rx) : __fifo_size(softio->tx);
+	if (length < 254 + 8) return 254;
+	length -= 8;  // head, xlength, checksum and the empty slot of fifo
+	return length > 0xFFFF ? 0xFFFF : length;
+}
+static inline void __softio_head_enque_extend(Fifo_t* tx, SoftIO_Trans_t* tptr) {
+	assert((size_t)fifo_remain(tx) >= sizeof(SoftIO_Head_t) + 2 && "cannot push head inside fifo");
+	__softio_head_enque(tx, &tptr->head);
+	fifo_enque(tx, tptr->xlength);
+	fifo_enque(tx, tptr->xlength >> 8);
+}
+
+// (host) start resync, see __softio_error. SOFTIO_EXT_SYNC is sent at once without credits, since remote discards rx anyway.
+//   remote restarts credit counting from it, so sync_sent marks it in credit_sent
+static inline void __softio_sync(SoftIO_t* softio) {
+	assert((softio->features & SOFTIO_FEATURE_RESYNC) && "corrupt frame and remote cannot resync, see softio->error");
+	softio->resync = SOFTIO_RESYNC_REPLY;
+	++softio->sync_id;
+	SoftIO_Trans_t sync;  // not stored, the reply is found by id
+	sync.head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	sync.head.addr = SOFTIO_SYNC_MAGIC;
+	sync.head.length = SOFTIO_EXT_SYNC;
+	sync.xlength = softio->sync_id;
+	if (softio->puts) __softio_puts_fifo_blocking(softio, softio->tx, 6);
+	__softio_head_enque_extend(softio->tx, &sync);
+	softio->credit_sent += 6;
+	softio->sync_sent = softio->credit_sent;
+	if (softio->puts) softio_flush_fifo(*softio, *softio->tx);
+}
+static inline void __softio_replay_enque(SoftIO_t* softio, SoftIO_Trans_t* tptr) {
+	if (tptr->head.type == SOFTIO_HEAD_TYPE_EXTEND) __softio_head_enque_extend(softio->tx, tptr);
+	else __softio_head_enque(softio->tx, &tptr->head);
+	if (tptr->head.type == SOFTIO_HEAD_TYPE_WRITE || (tptr->head.type == SOFTIO_HEAD_TYPE_EXTEND && tptr->head.length == SOFTIO_EXT_WRITE)) {
+		uint32_t length = tptr->head.type == SOFTIO_HEAD_TYPE_WRITE ? tptr->head.length : tptr->xlength;
+		__softio_enque_sum(softio->tx, softio->base + tptr->head.addr, length);  // what local memory has now
+		__softio_shadow_update(softio, tptr->head.addr, length);
+	}
+}
+static inline void __softio_tagged_enque(SoftIO_t* softio, uint32_t tag) {
+	SoftIO_Trans_t trans;
+	trans.head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	trans.head.addr = softio->tagged[tag].addr;
+	trans.head.length = SOFTIO_EXT_READ_TAGGED;
+	trans.xlength = softio->tagged[tag].length;
+	__softio_head_enque_extend(softio->tx, &trans);
+	fifo_enque(softio->tx, tag);
+}
+
+// (host) send again the next transaction or tagged read kept by resync, return 0 if tx is not ready for it
+static inline char __softio_replay_one(SoftIO_t* softio) {
+	SoftIO_Trans_t* tptr = NULL;
+	uint32_t n = 6 + 1, tag = 0;
+	if (softio->replay) {
+		tptr = softio->transactions + (softio->write - softio->replay + softio->length) % softio->length;
+		n = __softio_replay_size(tptr);
+	} else while (!(softio->tag_replay & (1u << tag))) ++tag;
+	if (!__softio_tx_ready(softio, n)) return 0;
+	softio->credit_sent += n;
+	if (tptr) {
+		tptr->seq = softio->issued++;
+		__softio_replay_enque(softio, tptr);
+		--softio->replay;
+	} else {
+		++softio->issued;
+		__softio_tagged_enque(softio, tag);
+		softio->tag_replay &= ~(1u << tag);
+	}
+	return 1;
+}
+// (host) before anything is sent or waited: wait for the reply of SOFTIO_EXT_SYNC, then send again what resync has kept
+static inline void __softio_settle(SoftIO_t* softio) {
+	while (softio->resync || softio->replay || softio->tag_replay) {
+		if (softio->resync) {
+			__softio_wait_frame(softio);
+			continue;
+		}
+		if (__softio_replay_one(softio)) continue;
+		softio_flush(*softio);  // like __softio_tx_reserve, transactions before it are in flight
+		if (!__softio_replay_one(softio)) __softio_wait_frame(softio);
+	}
+}
+// (host) whether softio_delay_xxx of a frame of n bytes would return at once: settled, window has a slot and tx is ready
+static inline char __softio_can_issue(SoftIO_t* softio, uint32_t n) {
+	return !softio->resync && !softio->replay && !softio->tag_replay && (softio->write + 1) % softio->length != softio->read
+		&& __softio_tx_ready(softio, n);
+}
+#define softio_can_issue(softio, n) __softio_can_issue(&(softio), n)
+// (host) non-blocking progress, for an event loop that moves bytes between port and rx/tx by itself instead of gets and puts:
+//   handle frames in rx, then send again what resync has kept as far as tx is ready. return what it needs like __softio_try_handle_one
+static inline int __softio_progress(SoftIO_t* softio) {
+	int need;
+	while ((need = __softio_try_handle_one(softio)) == 0);
+	while (!softio->resync && (softio->replay || softio->tag_replay) && __softio_replay_one(softio));
+	return need;
+}
+#define softio_progress(softio) __softio_progress(&(softio))
+
+static inline void __softio_delay_read_extend_no_check(SoftIO_t* softio, uint32_t addr, uint32_t length) {
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+	__softio_tx_reserve(softio, 6);  // sending queue or remote rx is full, wait
+#endif
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = addr;
+	tptr->head.length = SOFTIO_EXT_READ;
+	tptr->xlength = length;
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	__softio_head_enque_extend(softio->tx, tptr);
+}
 static inline void __softio_delay_read(SoftIO_t* softio, void* addr, uint32_t length) {
 	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "read range exceeded");
 	uint32_t bias = 0;
 	uint32_t startaddr = (char*)addr - softio->base;
+	uint32_t max_length = __softio_max_length(softio);
 	while (bias < length) {
-		int len = (length - bias) > 254 ? 254 : (length - bias);  // maximum length is 254
-		__softio_delay_read_no_check(softio, startaddr + bias, len);
+		uint32_t len = (length - bias) > max_length ? max_length : (length - bias);
+		if (len > 254) __softio_delay_read_extend_no_check(softio, startaddr + bias, len);
+		else __softio_delay_read_no_check(softio, startaddr + bias, len);
 		bias += len;
 	}
 }
 #define softio_delay_read(softio, var) __softio_delay_read(&(softio), &(var), sizeof(var))
+
+// tagged read of at most 254 bytes, which doesn't hold replies of other transactions while slave defers it (see `ready`).
+//   return the tag to wait for by softio_wait_tag. reads after it may be replied first, so they don't see what it sees
+static inline uint32_t __softio_delay_read_tagged(SoftIO_t* softio, void* addr, uint32_t length) {
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "read range exceeded");
+	assert(length != 0 && length < 255 && "tagged read is at most 254 bytes");
+	if (!(softio->features & SOFTIO_FEATURE_TAGGED)) {  // remote doesn't support, use normal read
+		__softio_delay_read(softio, addr, length);
+		return SOFTIO_TAG_NONE;
+	}
+	const uint32_t all = 0xFFFFFFFFu >> (32 - SOFTIO_TAG_LENGTH);
+	while ((softio->tags & all) == all) {  // all tags are pending, wait one
+		__softio_settle(softio);
+		softio_flush(*softio);
+		if ((softio->tags & all) == all) __softio_wait_frame(softio);
+	}
+	__softio_tx_reserve(softio, 6 + 1);  // sending queue or remote rx is full, wait
+	uint32_t tag = 0;
+	while (softio->tags & (1u << tag)) ++tag;
+	softio->tagged[tag].type = SOFTIO_HEAD_TYPE_READ;
+	softio->tagged[tag].addr = (char*)addr - softio->base;
+	softio->tagged[tag].length = length;
+	softio->tags |= 1u << tag;
+	__softio_tagged_enque(softio, tag);
+	return tag;
+}
+#define softio_delay_read_tagged(softio, var) __softio_delay_read_tagged(&(softio), &(var), sizeof(var))
+#define softio_delay_read_tagged_between(softio, var1, var2) __softio_delay_read_tagged(&(softio), &(var1), \
+	(char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
 #define softio_delay_read_between(softio, var1, var2) __softio_delay_read(&(softio), &(var1), (char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
 
+#define softio_region_count(softio) (((softio).region_write - (softio).region_read + SOFTIO_REGION_LENGTH) % SOFTIO_REGION_LENGTH)
+// regions are already in SoftIO_Head_t format inside region ring, from `first` with `count` regions and `length` bytes in total
+static inline void __softio_delay_read_multi_no_check(SoftIO_t* softio, uint32_t first, uint32_t count, uint32_t length) {
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+	__softio_tx_reserve(softio, 7 + 4 * count);  // sending queue or remote rx is full, wait
+#endif
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = 0;
+	tptr->head.length = SOFTIO_EXT_READ_MULTI;
+	tptr->xlength = length;
+	tptr->xcount = count;
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	__softio_head_enque(softio->tx, &tptr->head);
+	fifo_enque(softio->tx, count);
+	fifo_enque(softio->tx, count >> 8);
+	char sum = 0;
+	for (uint32_t i=0; i<count; ++i) {
+		char* buf = (char*)(void*)(softio->regions + (first + i) % SOFTIO_REGION_LENGTH);
+		for (size_t j=0; j<sizeof(SoftIO_Head_t); ++j) {
+			sum += buf[j];
+			fifo_enque(softio->tx, buf[j]);
+		}
+	}
+	fifo_enque(softio->tx, -sum);
+}
+// read several regions in one transaction, data is filled into local memory just like softio_delay_read
+//   falls back to separate reads if remote doesn't support it. regions are split into 254 byte pieces and packed into as few transactions as possible
+static inline void __softio_delay_read_multi(SoftIO_t* softio, const SoftIO_Region_t* regions, uint32_t count) {
+	if (!(softio->features & SOFTIO_FEATURE_EXTEND)) {
+		for (uint32_t i=0; i<count; ++i) __softio_delay_read(softio, regions[i].addr, regions[i].length);
+		return;
+	}
+	uint32_t max_length = __softio_max_length(softio);
+	uint32_t max_count = max_length / 4 < SOFTIO_REGION_LENGTH - 1 ? max_length / 4 : SOFTIO_REGION_LENGTH - 1;
+	uint32_t first = softio->region_write, pending = 0, length = 0;
+	for (uint32_t i=0; i<count; ++i) {
+		assert(softio->base <= (char*)regions[i].addr && softio->base + softio->size >= (char*)regions[i].addr + regions[i].length && "read range exceeded");
+		uint32_t startaddr = (char*)regions[i].addr - softio->base;
+		for (uint32_t bias=0; bias<regions[i].length; ) {
+			uint32_t len = (regions[i].length - bias) > 254 ? 254 : (regions[i].length - bias);
+			if (pending == max_count || length + len > max_length) {  // send what we have
+				__softio_delay_read_multi_no_check(softio, first, pending, length);
+				first = softio->region_write; pending = 0; length = 0;
+			}
+#ifndef NOT_HANDLE_RESPOND
+			while (softio_region_count(*softio) + 1 >= SOFTIO_REGION_LENGTH) __softio_wait_one(softio);  // region ring is full, wait
+#endif
+			SoftIO_Head_t* region = softio->regions + softio->region_write;
+			region->type = SOFTIO_HEAD_TYPE_READ;
+			region->addr = startaddr + bias;
+			region->length = len;
+			softio->region_write = (softio->region_write + 1) % SOFTIO_REGION_LENGTH;
+			++pending; length += len; bias += len;
+		}
+	}
+	if (pending) __softio_delay_read_multi_no_check(softio, first, pending, length);
+}
+#define softio_delay_read_multi(softio, regions, count) __softio_delay_read_multi(&(softio), regions, count)
+
 static inline void __softio_delay_write_no_check(SoftIO_t* softio, uint32_t addr, uint32_t length) {
 #ifndef NOT_HANDLE_RESPOND
 	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
-	while (fifo_remain(softio->tx) < 5 + length) __softio_wait_one(softio);  // sending queue is full, wait
+	__softio_tx_reserve(softio, 5 + length);  // sending queue or remote rx is full, wait
 #endif
-	SoftIO_Head_t* tptr = softio->transactions + softio->write;
+	SoftIO_Head_t* tptr = &softio->transactions[softio->write].head;
 	tptr->type = SOFTIO_HEAD_TYPE_WRITE;
 	tptr->addr = addr;
 	tptr->length = length;
@@ -461,32 +1916,227 @@ static inline void __softio_delay_write_no_check(SoftIO_t* softio, uint32_t addr
 	softio->write = (softio->write + 1) % softio->length;
 #endif
 	__softio_head_enque(softio->tx, tptr);
-	char sum = 0;
-	for (uint32_t i=0; i<length; ++i) {
-		sum += softio->base[addr + i];
-		fifo_enque(softio->tx, softio->base[addr + i]);
-	}
-	fifo_enque(softio->tx, -sum);
+	__softio_enque_sum(softio->tx, softio->base + addr, length);
+	__softio_shadow_update(softio, addr, length);
+}
+static inline void __softio_delay_write_extend_no_check(SoftIO_t* softio, uint32_t addr, uint32_t length) {
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+	__softio_tx_reserve(softio, 7 + length);  // sending queue or remote rx is full, wait
+#endif
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = addr;
+	tptr->head.length = SOFTIO_EXT_WRITE;
+	tptr->xlength = length;
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	__softio_head_enque_extend(softio->tx, tptr);
+	__softio_enque_sum(softio->tx, softio->base + addr, length);
+	__softio_shadow_update(softio, addr, length);
 }
 static inline void __softio_delay_write(SoftIO_t* softio, void* addr, uint32_t length) {
 	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "write range exceeded");
 	uint32_t bias = 0;
 	uint32_t startaddr = (char*)addr - softio->base;
+	uint32_t max_length = __softio_max_length(softio);
 	while (bias < length) {
-		int len = (length - bias) > 254 ? 254 : (length - bias);  // maximum length is 254
-		__softio_delay_write_no_check(softio, startaddr + bias, len);
+		uint32_t len = (length - bias) > max_length ? max_length : (length - bias);
+		if (len > 254) __softio_delay_write_extend_no_check(softio, startaddr + bias, len);
+		else __softio_delay_write_no_check(softio, startaddr + bias, len);
 		bias += len;
 	}
 }
 #define softio_delay_write(softio, var) __softio_delay_write(&(softio), &(var), sizeof(var))
 #define softio_delay_write_between(softio, var1, var2) __softio_delay_write(&(softio), &(var1), (char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
 
+// posted write doesn't take transaction slot and remote never replies, so it's only limited by link bandwidth.
+//   use softio_delay_fence (or softio_blocking(fence, softio)) when you need to know they're done
+static inline void __softio_delay_write_posted_no_check(SoftIO_t* softio, uint32_t addr, uint32_t length) {
+	__softio_tx_reserve(softio, 7 + length);  // sending queue or remote rx is full, wait
+	SoftIO_Trans_t posted;  // not stored
+	posted.head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	posted.head.addr = addr;
+	posted.head.length = SOFTIO_EXT_WRITE_POSTED;
+	posted.xlength = length;
+	__softio_head_enque_extend(softio->tx, &posted);
+	__softio_enque_sum(softio->tx, softio->base + addr, length);
+	__softio_shadow_update(softio, addr, length);
+}
+static inline void __softio_delay_write_posted(SoftIO_t* softio, void* addr, uint32_t length) {
+	if (!(softio->features & SOFTIO_FEATURE_POSTED)) {  // remote doesn't support, use normal write
+		__softio_delay_write(softio, addr, length);
+		return;
+	}
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "write range exceeded");
+	uint32_t bias = 0;
+	uint32_t startaddr = (char*)addr - softio->base;
+	uint32_t max_length = __softio_max_length(softio);
+	while (bias < length) {
+		uint32_t len = (length - bias) > max_length ? max_length : (length - bias);
+		__softio_delay_write_posted_no_check(softio, startaddr + bias, len);
+		bias += len;
+	}
+}
+#define softio_delay_write_posted(softio, var) __softio_delay_write_posted(&(softio), &(var), sizeof(var))
+#define softio_delay_write_posted_between(softio, var1, var2) __softio_delay_write_posted(&(softio), &(var1), (char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
+
+// a round trip that finishes after all requests before it, including posted writes. do nothing if remote has no posted write
+static inline void __softio_delay_fence(SoftIO_t* softio) {
+	if (!(softio->features & SOFTIO_FEATURE_POSTED)) return;  // all writes are acknowledged
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+	__softio_tx_reserve(softio, 6);  // sending queue or remote rx is full, wait
+#endif
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = 0;
+	tptr->head.length = SOFTIO_EXT_FENCE;
+	tptr->xlength = 0;
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	__softio_head_enque_extend(softio->tx, tptr);
+}
+#define softio_delay_fence(softio) __softio_delay_fence(&(softio))
+
+// handshake of credit flow control, host could keep as many bytes in flight as remote rx holds after it's done.
+//   do nothing if remote doesn't support it
+static inline void __softio_delay_credit(SoftIO_t* softio) {
+	if (!(softio->features & SOFTIO_FEATURE_CREDIT)) return;
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+#endif
+	softio->credit_capacity = 0;  // disabled until reply, counters restart from this request
+	softio->credit_sent = 0;
+	__softio_tx_reserve(softio, 6);
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = 0;
+	tptr->head.length = SOFTIO_EXT_CREDIT;
+	tptr->xlength = 0;
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	__softio_head_enque_extend(softio->tx, tptr);
+}
+#define softio_delay_credit(softio) __softio_delay_credit(&(softio))
+
+// subscribe [addr, addr+length) with `id`, set `softio.subs[id].callback` before if you want to be notified.
+//   length=0 to unsubscribe, pushes may still come until the reply. do nothing if remote doesn't support it
+static inline void __softio_delay_subscribe(SoftIO_t* softio, uint32_t id, void* addr, uint32_t length, uint32_t period, uint32_t flags) {
+	if (!(softio->features & SOFTIO_FEATURE_PUSH)) return;
+	assert(id < SOFTIO_SUB_LENGTH && "invalid subscription id");
+	if (flags & SOFTIO_SUB_FIFO) {
+		assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + sizeof(Fifo_t) && "subscribe fifo range exceeded");
+		assert(length < 255 && "fifo push length invalid");
+	} else assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "subscribe range exceeded");
+	assert(length <= __softio_max_length(softio) && period <= 0xFFFF && "invalid subscription");
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+	__softio_tx_reserve(softio, 6 + 4 + 1);  // sending queue or remote rx is full, wait
+#endif
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = (char*)addr - softio->base;
+	tptr->head.length = SOFTIO_EXT_SUBSCRIBE;
+	tptr->xlength = length;
+	tptr->xcount = id;  // to find the subscription at reply
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	if (length) {  // unsubscribed one is removed at reply
+		softio->subs[id].addr = tptr->head.addr;
+		softio->subs[id].length = length;
+		softio->subs[id].period = period;
+		softio->subs[id].flags = flags;
+	}
+	__softio_head_enque_extend(softio->tx, tptr);
+	char payload[4] = { (char)id, (char)flags, (char)period, (char)(period >> 8) };
+	__softio_enque_sum(softio->tx, payload, 4);
+}
+#define softio_delay_subscribe(softio, id, var, period, flags) __softio_delay_subscribe(&(softio), id, &(var), sizeof(var), period, flags)
+#define softio_delay_subscribe_between(softio, id, var1, var2, period, flags) __softio_delay_subscribe(&(softio), id, &(var1), \
+	(char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2), period, flags)
+// drain remote fifo into local one at most `length` bytes a push, every `period` ticks
+#define softio_delay_subscribe_fifo(softio, id, var, length, period) __softio_delay_subscribe(&(softio), id, &(var), length, period, SOFTIO_SUB_FIFO)
+#define softio_delay_unsubscribe(softio, id) __softio_delay_subscribe(&(softio), id, (softio).base, 0, 0, 0)
+
+// track [addr, addr+length) of memory with a shadow buffer of `length` bytes. local memory is assumed to be the same as remote now,
+//   so call it right after they're synchronized, or read the range after it
+static inline void __softio_track(SoftIO_t* softio, char* shadow, void* addr, uint32_t length) {
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "track range exceeded");
+	softio->shadow = shadow;
+	softio->shadow_begin = (char*)addr - softio->base;
+	softio->shadow_end = softio->shadow_begin + length;
+	softio->shadow_fields = NULL;
+	memcpy(shadow, addr, length);
+}
+#define softio_track_between(softio, shadow, var1, var2) __softio_track(&(softio), shadow, &(var1), (char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
+// fields of tracked range with write hooks on remote are marked in a buffer of a byte for each tracked byte, see softio_track_hooked
+static inline void __softio_track_fields(SoftIO_t* softio, char* fields) {
+	softio->shadow_fields = fields;
+	memset(fields, 0, softio->shadow_end - softio->shadow_begin);
+}
+#define softio_track_fields(softio, fields) __softio_track_fields(&(softio), fields)
+// remote has a write hook on [addr, addr+length), which is only called by a write including all of it. so softio_delay_sync_dirty
+//   writes the field as a whole if any byte of it is dirty, and never merges it into a write when it's clean
+static inline void __softio_track_hooked(SoftIO_t* softio, void* addr, uint32_t length) {
+	assert(softio->shadow_fields && "call softio_track_fields first");
+	assert(softio->base + softio->shadow_begin <= (char*)addr && softio->base + softio->shadow_end >= (char*)addr + length && length && "field outside tracked range");
+	uint32_t at = (char*)addr - softio->base - softio->shadow_begin;
+	char* fields = softio->shadow_fields;
+	char id = 1;
+	while ((at > 0 && fields[at-1] == id) || (softio->shadow_begin + at + length < softio->shadow_end && fields[at+length] == id)) ++id;
+	memset(fields + at, id, length);  // differs from neighbours, so adjacent fields are not taken as one
+}
+#define softio_track_hooked(softio, var) __softio_track_hooked(&(softio), &(var), sizeof(var))
+static inline char __softio_track_has_hooked(SoftIO_t* softio, uint32_t begin, uint32_t end) {
+	if (softio->shadow_fields) for (; begin < end; ++begin) if (softio->shadow_fields[begin]) return 1;
+	return 0;
+}
+// write all the changed bytes of [addr, addr+length) in tracked range, ranges with gaps no more than SOFTIO_DIRTY_GAP are merged into
+//   one unless the gap has a hooked field. note that merged gaps are written with local value, so don't let them cover variables
+//   changed by remote. they're sent as posted writes with a fence if remote supports, so softio_blocking(sync_dirty, softio) is one round trip
+static inline void __softio_delay_sync_dirty(SoftIO_t* softio, void* addr, uint32_t length) {
+	if (!softio->shadow) return;
+	assert(softio->base + softio->shadow_begin <= (char*)addr && softio->base + softio->shadow_end >= (char*)addr + length && "sync outside tracked range");
+	char* local = softio->base + softio->shadow_begin;
+	const char* fields = softio->shadow_fields;
+	uint32_t from = (char*)addr - local;
+	uint32_t to = from + length;
+	uint32_t begin = from, end = from;  // the pending dirty range, empty if begin == end
+	char dirty = 0;
+	for (uint32_t i=from; i<to; ) {
+		if (i + 8 <= to && memcmp(local + i, softio->shadow + i, 8) == 0) { i += 8; continue; }  // skip clean words
+		if (local[i] == softio->shadow[i]) { ++i; continue; }
+		uint32_t first = i++;
+		if (fields && fields[first]) {  // the whole field
+			while (first > end && fields[first-1] == fields[i-1]) --first;
+			while (i < to && fields[i] == fields[first]) ++i;
+		}
+		if (begin != end && (first - end > SOFTIO_DIRTY_GAP || __softio_track_has_hooked(softio, end, first))) {  // too far, send pending one
+			__softio_delay_write_posted(softio, local + begin, end - begin);
+			begin = end;
+		}
+		if (begin == end) begin = first;
+		end = i;
+		dirty = 1;
+	}
+	if (begin != end) __softio_delay_write_posted(softio, local + begin, end - begin);
+	if (dirty) __softio_delay_fence(softio);
+}
+#define softio_delay_sync_dirty(softio) __softio_delay_sync_dirty(&(softio), (softio).base + (softio).shadow_begin, (softio).shadow_end - (softio).shadow_begin)
+// only the part of [var1, var2], e.g., to apply a configuration before the field enabling it
+#define softio_delay_sync_dirty_between(softio, var1, var2) __softio_delay_sync_dirty(&(softio), &(var1), (char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
+
 static inline void __softio_delay_read_fifo_no_check(SoftIO_t* softio, uint32_t addr, uint32_t length) {
 #ifndef NOT_HANDLE_RESPOND
 	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
-	while (fifo_remain(softio->tx) < 4) __softio_wait_one(softio);  // sending queue is full, wait
+	__softio_tx_reserve(softio, 4);  // sending queue or remote rx is full, wait
 #endif
-	SoftIO_Head_t* tptr = softio->transactions + softio->write;
+	SoftIO_Head_t* tptr = &softio->transactions[softio->write].head;
 	tptr->type = SOFTIO_HEAD_TYPE_READ_FIFO;
 	tptr->addr = addr;
 	tptr->length = length;
@@ -508,9 +2158,9 @@ static inline void __softio_delay_read_fifo(SoftIO_t* softio, Fifo_t* addr, uint
 static inline void __softio_delay_write_fifo_no_check(SoftIO_t* softio, uint32_t addr, uint32_t length, Fifo_t* fifo) {
 #ifndef NOT_HANDLE_RESPOND
 	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
-	while (fifo_remain(softio->tx) < 5 + length) __softio_wait_one(softio);  // sending queue is full, wait
+	__softio_tx_reserve(softio, 5 + length);  // sending queue or remote rx is full, wait
 #endif
-	SoftIO_Head_t* tptr = softio->transactions + softio->write;
+	SoftIO_Head_t* tptr = &softio->transactions[softio->write].head;
 	tptr->type = SOFTIO_HEAD_TYPE_WRITE_FIFO;
 	tptr->addr = addr;
 	tptr->length = length;
@@ -518,13 +2168,7 @@ static inline void __softio_delay_write_fifo_no_check(SoftIO_t* softio, uint32_t
 	softio->write = (softio->write + 1) % softio->length;
 #endif
 	__softio_head_enque(softio->tx, tptr);
-	char sum = 0;
-	for (uint32_t i=0; i<length; ++i) {
-		char a = fifo_deque(fifo);
-		sum += a;
-		fifo_enque(softio->tx, a);
-	}
-	fifo_enque(softio->tx, -sum);
+	fifo_enque(softio->tx, -__softio_fifo_move_sum(softio->tx, fifo, length));
 }
 static inline void __softio_delay_write_fifo(SoftIO_t* softio, Fifo_t* addr, uint32_t length) {
 	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + sizeof(Fifo_t) && "write fifo range exceeded");
@@ -539,9 +2183,9 @@ static inline void __softio_delay_clear_reset_fifo(SoftIO_t* softio, Fifo_t* add
 	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + sizeof(Fifo_t) && "fifo range exceeded");
 #ifndef NOT_HANDLE_RESPOND
 	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
-	while (fifo_remain(softio->tx) < 4) __softio_wait_one(softio);  // sending queue is full, wait
+	__softio_tx_reserve(softio, 4);  // sending queue or remote rx is full, wait
 #endif
-	SoftIO_Head_t* tptr = softio->transactions + softio->write;
+	SoftIO_Head_t* tptr = &softio->transactions[softio->write].head;
 	tptr->type = type;
 	tptr->addr = (char*)addr - softio->base;
 	tptr->length = 0;
@@ -553,37 +2197,210 @@ static inline void __softio_delay_clear_reset_fifo(SoftIO_t* softio, Fifo_t* add
 #define softio_delay_clear_fifo(softio, var) __softio_delay_clear_reset_fifo(&(softio), &(var), SOFTIO_HEAD_TYPE_CLEAR_FIFO)
 #define softio_delay_reset_fifo(softio, var) __softio_delay_clear_reset_fifo(&(softio), &(var), SOFTIO_HEAD_TYPE_RESET_FIFO)
 
+// atomic read-modify-write of an aligned 1, 2 or 4 byte word of remote, see SOFTIO_ATOMIC_xxx. when it returns, local word has the new
+//   value and *old has the old one (old could be NULL). without SOFTIO_FEATURE_ATOMIC, it's a blocking read and a write, not atomic then
+static inline void __softio_delay_atomic(SoftIO_t* softio, void* addr, uint32_t width, uint32_t op, uint32_t a, uint32_t b, uint32_t* old) {
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + width && "atomic range exceeded");
+	assert((width == 1 || width == 2 || width == 4) && ((char*)addr - softio->base) % width == 0 && "invalid atomic word");
+	if (!(softio->features & SOFTIO_FEATURE_ATOMIC)) {
+		__softio_delay_read(softio, addr, width);
+		softio_wait_delayed(*softio);
+		uint32_t value = 0;
+		memcpy(&value, addr, width);  // little endian
+		if (old) *old = value;
+		uint32_t result = __softio_atomic_apply(op, value, a, b, width);
+		if (result != value) {
+			memcpy(addr, &result, width);
+			__softio_delay_write(softio, addr, width);
+		}
+		return;
+	}
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+	__softio_tx_reserve(softio, 6 + 9 + 1);  // sending queue or remote rx is full, wait
+#endif
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = (char*)addr - softio->base;
+	tptr->head.length = SOFTIO_EXT_ATOMIC;
+	tptr->xlength = width;
+	tptr->result = old;
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	__softio_head_enque_extend(softio->tx, tptr);
+	char arg[10];
+	arg[0] = op;
+	memcpy(arg + 1, &a, 4);  // little endian
+	memcpy(arg + 5, &b, 4);
+	arg[9] = -__softio_sum(arg, 9);
+	fifo_copy_from_buffer(softio->tx, arg, 10);
+}
+#define softio_delay_fetch_add(softio, var, value, old) __softio_delay_atomic(&(softio), &(var), sizeof(var), SOFTIO_ATOMIC_ADD, value, 0, old)
+#define softio_delay_cas(softio, var, expected, desired, old) __softio_delay_atomic(&(softio), &(var), sizeof(var), SOFTIO_ATOMIC_CAS, expected, desired, old)
+#define softio_delay_set_bits(softio, var, bits, old) __softio_delay_atomic(&(softio), &(var), sizeof(var), SOFTIO_ATOMIC_SET, bits, 0, old)
+#define softio_delay_clear_bits(softio, var, bits, old) __softio_delay_atomic(&(softio), &(var), sizeof(var), SOFTIO_ATOMIC_CLEAR, bits, 0, old)
+#define softio_delay_write_masked(softio, var, mask, value, old) __softio_delay_atomic(&(softio), &(var), sizeof(var), SOFTIO_ATOMIC_MASKED, mask, value, old)
+
+// build a stored program in `buf` of local memory, see SOFTIO_PROG_WAIT. instructions are appended by softio_prog_xxx, then
+//   softio_delay_upload puts it into remote and softio_delay_run runs it. a program could be run again without upload
+static inline void __softio_prog_init(SoftIO_t* softio, SoftIO_Prog_t* prog, char* buf, uint32_t size) {
+	assert(softio->base <= buf && softio->base + softio->size >= buf + size && "program outside shared space");
+	prog->addr = buf - softio->base;
+	prog->size = size > 0xFFFF ? 0xFFFF : size;
+	prog->length = 0;
+	prog->reply = 1;
+	prog->count = 0;
+}
+#define softio_prog_init(softio, prog, buf) __softio_prog_init(&(softio), &(prog), buf, sizeof(buf))
+static inline char* __softio_prog_append(SoftIO_t* softio, SoftIO_Prog_t* prog, uint32_t type, uint32_t addr, uint32_t length, uint32_t extra) {
+	assert(prog->length + 4 + extra <= prog->size && "program buffer overflow");
+	assert(prog->count < 255 && "too many instructions");
+	SoftIO_Head_t head;
+	head.type = type;
+	head.addr = addr;
+	head.length = length;
+	char* inst = softio->base + prog->addr + prog->length;
+	memcpy(inst, &head, sizeof(head));
+	prog->length += 4 + extra;
+	++prog->count;
+	return inst + 4;
+}
+// read or write of any length is split into 254 byte instructions. write takes the current value of local memory
+static inline void __softio_prog_read_write(SoftIO_t* softio, SoftIO_Prog_t* prog, uint32_t type, void* addr, uint32_t length) {
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "program access outside shared space");
+	for (uint32_t bias=0; bias<length; bias+=254) {
+		uint32_t len = (length - bias) > 254 ? 254 : (length - bias);
+		char* data = __softio_prog_append(softio, prog, type, (char*)addr - softio->base + bias, len, type == SOFTIO_HEAD_TYPE_WRITE ? len : 0);
+		if (type == SOFTIO_HEAD_TYPE_WRITE) memcpy(data, (char*)addr + bias, len);
+		else prog->reply += len;
+	}
+	assert(5u + prog->reply <= fifo_capacity(softio->rx) && "reply larger than rx fifo");
+}
+#define softio_prog_read(softio, prog, var) __softio_prog_read_write(&(softio), &(prog), SOFTIO_HEAD_TYPE_READ, &(var), sizeof(var))
+#define softio_prog_read_between(softio, prog, var1, var2) __softio_prog_read_write(&(softio), &(prog), SOFTIO_HEAD_TYPE_READ, &(var1), \
+	(char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
+#define softio_prog_write(softio, prog, var) __softio_prog_read_write(&(softio), &(prog), SOFTIO_HEAD_TYPE_WRITE, &(var), sizeof(var))
+#define softio_prog_write_between(softio, prog, var1, var2) __softio_prog_read_write(&(softio), &(prog), SOFTIO_HEAD_TYPE_WRITE, &(var1), \
+	(char*)(void*)(&(var2)) - (char*)(void*)(&(var1)) + sizeof(var2))
+static inline void __softio_prog_fifo(SoftIO_t* softio, SoftIO_Prog_t* prog, uint32_t type, Fifo_t* addr, uint32_t length) {
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + sizeof(Fifo_t) && "fifo range exceeded");
+	__softio_prog_append(softio, prog, type, (char*)addr - softio->base, length, 0);
+	if (type == SOFTIO_HEAD_TYPE_READ_FIFO) {
+		assert(length >= 1 && length < 255 && "fifo read length invalid");
+		prog->reply += 1 + length;
+		assert(5u + prog->reply <= fifo_capacity(softio->rx) && "reply larger than rx fifo");
+	}
+}
+#define softio_prog_read_fifo_part(softio, prog, var, length) __softio_prog_fifo(&(softio), &(prog), SOFTIO_HEAD_TYPE_READ_FIFO, &(var), length)
+#define softio_prog_clear_fifo(softio, prog, var) __softio_prog_fifo(&(softio), &(prog), SOFTIO_HEAD_TYPE_CLEAR_FIFO, &(var), 0)
+#define softio_prog_reset_fifo(softio, prog, var) __softio_prog_fifo(&(softio), &(prog), SOFTIO_HEAD_TYPE_RESET_FIFO, &(var), 0)
+static inline void __softio_prog_wait(SoftIO_t* softio, SoftIO_Prog_t* prog, void* addr, uint32_t length, uint32_t mask, uint32_t value, uint32_t timeout) {
+	assert(softio->base <= (char*)addr && softio->base + softio->size >= (char*)addr + length && "program access outside shared space");
+	assert((length == 1 || length == 2 || length == 4) && "invalid wait variable");
+	assert(timeout <= SOFTIO_PROG_WAIT_MAX && "timeout too long, slave doesn't handle rx while waiting");
+	char* arg = __softio_prog_append(softio, prog, SOFTIO_PROG_WAIT, (char*)addr - softio->base, length, 10);
+	memcpy(arg, &mask, 4);  // little endian
+	memcpy(arg + 4, &value, 4);
+	arg[8] = timeout; arg[9] = timeout >> 8;
+}
+#define softio_prog_wait(softio, prog, var, mask, value, timeout) __softio_prog_wait(&(softio), &(prog), &(var), sizeof(var), mask, value, timeout)
+
+static inline void __softio_delay_upload(SoftIO_t* softio, SoftIO_Prog_t* prog) {
+	if (!(softio->features & SOFTIO_FEATURE_PROGRAM) || !prog->length) return;  // host runs it by itself
+	__softio_delay_write_posted(softio, softio->base + prog->addr, prog->length);
+}
+#define softio_delay_upload(softio, prog) __softio_delay_upload(&(softio), &(prog))
+
+// remote doesn't support programs: requests are sent one by one, and waits are polled
+static inline void __softio_delay_run_fallback(SoftIO_t* softio, SoftIO_Prog_t* prog) {
+	const char* inst = softio->base + prog->addr;
+	SoftIO_Head_t head;
+	uint32_t executed = 0;
+	for (uint32_t i=0; i<prog->length; i+=__softio_prog_step(inst + i), ++executed) {
+		memcpy(&head, inst + i, sizeof(head));
+		switch (head.type) {
+		case SOFTIO_HEAD_TYPE_READ:
+			__softio_delay_read(softio, softio->base + head.addr, head.length);
+			break;
+		case SOFTIO_HEAD_TYPE_WRITE:
+			memcpy(softio->base + head.addr, inst + i + 4, head.length);
+			__softio_delay_write(softio, softio->base + head.addr, head.length);
+			break;
+		case SOFTIO_HEAD_TYPE_READ_FIFO:
+			__softio_delay_read_fifo(softio, (Fifo_t*)(softio->base + head.addr), head.length);
+			break;
+		case SOFTIO_HEAD_TYPE_CLEAR_FIFO:
+		case SOFTIO_HEAD_TYPE_RESET_FIFO:
+			__softio_delay_clear_reset_fifo(softio, (Fifo_t*)(softio->base + head.addr), head.type);
+			break;
+		case SOFTIO_PROG_WAIT: {
+			uint32_t mask, value, timeout = (uint32_t)(unsigned char)inst[i + 12] | ((uint32_t)(unsigned char)inst[i + 13] << 8);
+			memcpy(&mask, inst + i + 4, 4);
+			memcpy(&value, inst + i + 8, 4);
+			uint32_t start = softio->tick ? softio->tick() : 0;
+			while (1) {
+				__softio_delay_read(softio, softio->base + head.addr, head.length);
+				softio_wait_delayed(*softio);
+				uint32_t var = 0;
+				memcpy(&var, softio->base + head.addr, head.length);
+				if ((var & mask) == value) break;
+				if (!softio->tick || (uint32_t)(softio->tick() - start) >= timeout) {
+					softio->executed = executed;
+					return;
+				}
+			}
+			break; }
+		}
+	}
+	softio->executed = executed;
+}
+
+// run a program uploaded before, local memory gets all the reads when it returns just like softio_delay_read.
+//   `softio.executed` tells how many instructions are done
+static inline void __softio_delay_run(SoftIO_t* softio, SoftIO_Prog_t* prog) {
+	if (!(softio->features & SOFTIO_FEATURE_PROGRAM)) {
+		__softio_delay_run_fallback(softio, prog);
+		return;
+	}
+	assert(prog->length && "empty program");
+#ifndef NOT_HANDLE_RESPOND
+	if ((softio->write + 1) % softio->length == softio->read) __softio_wait_one(softio);  // queue is full, wait one
+	__softio_tx_reserve(softio, 6);  // sending queue or remote rx is full, wait
+#endif
+	SoftIO_Trans_t* tptr = softio->transactions + softio->write;
+	tptr->head.type = SOFTIO_HEAD_TYPE_EXTEND;
+	tptr->head.addr = prog->addr;
+	tptr->head.length = SOFTIO_EXT_RUN;
+	tptr->xlength = prog->length;
+#ifndef NOT_HANDLE_RESPOND
+	softio->write = (softio->write + 1) % softio->length;
+#endif
+	__softio_head_enque_extend(softio->tx, tptr);
+}
+#define softio_delay_run(softio, prog) __softio_delay_run(&(softio), &(prog))
+
 #define softio_dump(softio) do {\
 	int count = ((softio).write - (softio).read + (softio).length) % (softio).length;\
 	printf("softio \"%s\": base(0x%p), size(%u), transaction: length(%d), read(%d), write(%d), has (%d)\n", \
 		#softio, (softio).base, (softio).size, (softio).length, (softio).read, (softio).write, count);\
 	for (int i=0; i<count; ++i) {\
-		printf("   %2d: %s-%s addr(0x%05X) length(%u) raw(0x%08X)\n", i, SOFTIO_HEAD_TYPE_STR((softio).transactions[((softio).read + i) % (softio).length].type), \
-			SOFTIO_HEAD_TYPE_REQRET_STR((softio).transactions[((softio).read + i) % (softio).length].type), \
-			(softio).transactions[((softio).read + i) % (softio).length].addr, (softio).transactions[((softio).read + i) % (softio).length].length, \
-			*(uint32_t*)((void*)((softio).transactions + (((softio).read + i) % (softio).length)))); \
+		SoftIO_Trans_t* __tptr = (softio).transactions + ((softio).read + i) % (softio).length;\
+		printf("   %2d: %s-%s addr(0x%05X) length(%u) raw(0x%08X)", i, SOFTIO_HEAD_TYPE_STR(__tptr->head.type), \
+			SOFTIO_HEAD_TYPE_REQRET_STR(__tptr->head.type), __tptr->head.addr, __tptr->head.length, *(uint32_t*)((void*)&__tptr->head)); \
+		if (__tptr->head.type == SOFTIO_HEAD_TYPE_EXTEND) printf(" %s xlength(%u) xcount(%u)", SOFTIO_EXT_STR(__tptr->head.length), __tptr->xlength, __tptr->xcount);\
+		printf("\n");\
 	}\
 } while(0)
 
-// WARNING: could only dump 32bit machine's fifo
-#if __SIZEOF_POINTER__ == 8
+// the header of fifo is the same on both sides, so the remote one is read into var and printed
 #define softio_protected_dump_remote_fifo(prefix, softio, var) do {\
 	assert(&(var) != (softio).rx && &(var) != (softio).tx && "dump remote rx and tx not supported");\
 	softio_wait_all(softio);  /* finish all the transactions buffered */\
 	Fifo_t tmp = var;  /* save current state of local fifo */\
 	softio_blocking(read, softio, var);\
-	printf(prefix #var ": usage(%d/%d), read(%d), write(%d)\n", ((var).write - (var).read + (var).__H) % (var).__H, (var).__H, (var).read, (var).write);\
+	printf(prefix #var ": usage(%u/%u), read(%u), write(%u)\n", fifo_count(&(var)), fifo_capacity(&(var)), (var).read, (var).write);\
 	var = tmp;  /* restore state of local fifo */\
 } while (0)
-#else
-#define softio_protected_dump_remote_fifo(prefix, softio, var) do {\
-	assert(&(var) != (softio).rx && &(var) != (softio).tx && "dump remote rx and tx not supported");\
-	softio_wait_all(softio);  /* finish all the transactions buffered */\
-	Fifo_t tmp = var;  /* save current state of local fifo */\
-	softio_blocking(read, softio, var);\
-	printf(prefix #var ": usage(%d/%d), read(%d), write(%d)\n", ((var).write - (var).read + (var).length) % (var).length, (var).length, (var).read, (var).write);\
-	var = tmp;  /* restore state of local fifo */\
-} while (0)
-#endif
 
 #endif